@@ -0,0 +1,176 @@
+/** @file: atkin_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  For comparison, the Sieve of Atkin, computed a section at a time with the same
+ *  interface as sieve_stripe<T> and wheel_sieve<T>.
+ */
+
+#ifndef __ATKIN_SIEVE_TPP
+#define __ATKIN_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "parallel_sieve.tpp"
+#include "bit_extract.tpp"
+
+#include <vector>
+#include <cstdint>
+
+
+// --------------------------------------------------------------------------
+// class atkin_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Sieve of Atkin (Atkin and Bernstein, 2004).  A squarefree n > 3 is prime if and only if
+  *   - n % 12 is 1 or 5, and 4x^2 + y^2 = n has an odd number of solutions; or
+  *   - n % 12 is 7, and 3x^2 + y^2 = n has an odd number of solutions; or
+  *   - n % 12 is 11, and 3x^2 - y^2 = n, x > y, has an odd number of solutions,
+  * in positive integers x, y.  So we toggle n for each solution, and then clear the
+  * multiples of p^2 for the primes p >= 5.
+  *
+  * The odd numbers are stored one bit each in a std::vector<uint64_t>, bit i being 2i+1.
+  * As with sieve_stripe<T>, the constructor finds the small primes and allocates the
+  * sieve, and compute_section() can be called on sub-ranges, in any order; each section
+  * is cleared first, so computing a section twice does no harm.  A section only touches
+  * the words which its odd numbers are stored in.
+  *
+  * Each section loops over every x, and takes a square root for each, to find the y
+  * which land in the section: work of order sqrt(end) per section on top of the
+  * toggling, so the sections want to be larger than for sieve_stripe<T>.
+  */
+template <typename T>
+class atkin_sieve {
+public:
+	atkin_sieve(const T len);
+	bool is_prime(const T p)const;
+	void compute_section(T start, T end);
+	std::vector<T> prime_list()const;
+	const std::vector<uint64_t>& get_sieve()const { return sieve; }
+private:
+	T length;
+	std::vector<uint64_t> sieve;
+	std::vector<T> smallprimes;
+	void toggle(uint64_t n) { sieve[n/128] ^= uint64_t(1) << ((n/2)%64); }
+};
+
+/** Constructor: finds the primes up to sqrt(len) and allocates the (empty) sieve */
+template <typename T>
+atkin_sieve<T>::atkin_sieve(const T len)
+	: length{len}, sieve((static_cast<uint64_t>(len)+1)/128 + 1, 0)
+{
+	smallprimes = small_prime_list<T>(integer_sqrt(len) + 1);
+}
+
+template <typename T>
+bool atkin_sieve<T>::is_prime(const T p)const
+{
+	if ( p==2 ) { return length >= 2; }
+	if ( p<=1 or (p%2)==0 or p>length ) { return false; }
+	return ( sieve[p/128] >> ((p/2)%64) ) & 1;
+}
+
+/** Compute the sieve for [start, end].  The arithmetic is done in 64 bits, as 4x^2 + y^2
+  * can overflow T when end is close to the largest T. */
+template <typename T>
+void atkin_sieve<T>::compute_section(T start, T end)
+{
+	if ( end > length ) { end = length; }
+	uint64_t lo = ( start < 1 ) ? 1 : start;
+	uint64_t hi = end;
+	lo += 1 - (lo%2); // Ensure odd
+	if ( lo > hi ) { return; }
+
+	// Clear the bits for [lo, hi]
+	uint64_t first = lo/2, last = (hi-1)/2;
+	for (uint64_t i = first; i <= last; ) {
+		if ( i%64 == 0 and i + 63 <= last ) {
+			sieve[i/64] = 0;
+			i += 64;
+		} else {
+			sieve[i/64] &= ~(uint64_t(1) << (i%64));
+			++i;
+		}
+	}
+
+	auto ceil_sqrt = [](uint64_t v) {
+		uint64_t r = integer_sqrt(v);
+		return ( r*r < v ) ? r+1 : r;
+	};
+
+	// 4x^2 + y^2, with n % 12 in {1, 5}: n % 4 == 1, so y is odd
+	for (uint64_t x = 1; 4*x*x + 1 <= hi; ++x) {
+		uint64_t base = 4*x*x;
+		uint64_t y = ( base >= lo ) ? 1 : ceil_sqrt(lo - base);
+		y |= 1;
+		for (uint64_t n = base + y*y; n <= hi; n += 4*y+4, y += 2) {
+			unsigned int r = n%12;
+			if ( r==1 or r==5 ) { toggle(n); }
+		}
+	}
+	// 3x^2 + y^2, with n % 12 == 7: x is odd and y is even
+	for (uint64_t x = 1; 3*x*x + 4 <= hi; x += 2) {
+		uint64_t base = 3*x*x;
+		uint64_t y = ( base + 4 >= lo ) ? 2 : ceil_sqrt(lo - base);
+		y += y%2;
+		for (uint64_t n = base + y*y; n <= hi; n += 4*y+4, y += 2) {
+			if ( n%12 == 7 ) { toggle(n); }
+		}
+	}
+	// 3x^2 - y^2, x > y, with n % 12 == 11: x and y have opposite parity.  The smallest
+	// such n for a given x is 2x^2 + 2x - 1, at y = x-1.
+	for (uint64_t x = 2; 2*x*x + 2*x - 1 <= hi; ++x) {
+		uint64_t base = 3*x*x;
+		if ( base < lo + 1 ) { continue; }
+		uint64_t ymax = integer_sqrt(base - lo);
+		if ( ymax > x-1 ) { ymax = x-1; }
+		uint64_t y = ( base > hi ) ? ceil_sqrt(base - hi) : 1;
+		if ( (x+y)%2 == 0 ) { ++y; }
+		if ( y > ymax ) { continue; }
+		for (uint64_t n = base - y*y; y <= ymax; n -= 4*y+4, y += 2) {
+			if ( n%12 == 11 ) { toggle(n); }
+		}
+	}
+
+	// Remove the numbers which are not squarefree: the odd multiples of p^2
+	for (auto it = smallprimes.begin(); it != smallprimes.end(); ++it) {
+		uint64_t p = *it;
+		if ( p < 5 ) { continue; }
+		uint64_t psq = p*p;
+		if ( psq > hi ) { break; }
+		uint64_t k = (lo + psq - 1) / psq;
+		k |= 1;
+		for (uint64_t n = k*psq; n <= hi; n += 2*psq) {
+			sieve[n/128] &= ~(uint64_t(1) << ((n/2)%64));
+		}
+	}
+
+	if ( lo <= 3 and hi >= 3 ) { toggle(3); }
+}
+
+template <typename T>
+std::vector<T> atkin_sieve<T>::prime_list()const
+{
+	std::vector<T> primes;
+	primes.reserve(prime_count_upper_bound(length));
+	if ( length >= 2 ) { primes.push_back(2); }
+	// Bits for 1, 3, 5, ..., up to length
+	extract_bits_pushback(sieve.data(), (static_cast<std::size_t>(length)+1)/2, T(1), T(2), primes);
+	return primes;
+}
+
+/** Bit i is 2i+1: 512 bits cover 1024 integers. */
+template <typename T>
+struct sieve_alignment<atkin_sieve<T>> {
+	static T offset() { return 1; }
+	static T granule() { return 1024; }
+};
+
+
+
+/** Various testing routines */
+/** Tests that atkin_sieve agrees with prime_list, one section at a time and in parallel */
+bool test17();
+
+
+#endif // __ATKIN_SIEVE_TPP
@@ -0,0 +1,227 @@
+/** @file: batch_query.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Answering many small "primes in [a, b]" queries at once: sort them, join up those
+ *  which overlap or nearly touch, and sieve each joined run once, with one table of
+ *  sieving primes and scratch space which each thread keeps from batch to batch.
+ */
+
+#ifndef __BATCH_QUERY_TPP
+#define __BATCH_QUERY_TPP
+
+
+#include "sieve.tpp"
+#include "packed_sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+
+// --------------------------------------------------------------------------
+// struct prime_batch_result<T> code
+// --------------------------------------------------------------------------
+
+/** The answers to a batch of queries.  `primes` holds each prime in the union of the
+  * queries once, in order, and query i is answered by primes[ranges[i].first] up to (but
+  * not including) primes[ranges[i].second].  So overlapping queries share their primes.
+  */
+template <typename T>
+struct prime_batch_result {
+	std::vector<T> primes;
+	std::vector<std::pair<std::size_t, std::size_t>> ranges;
+	std::size_t size()const { return ranges.size(); }
+	std::size_t count(std::size_t i)const { return ranges[i].second - ranges[i].first; }
+	const T* begin(std::size_t i)const { return primes.data() + ranges[i].first; }
+	const T* end(std::size_t i)const { return primes.data() + ranges[i].second; }
+	std::vector<T> query(std::size_t i)const { return std::vector<T>(begin(i), end(i)); }
+};
+
+
+
+
+// --------------------------------------------------------------------------
+// class prime_batch_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Scratch space for one thread: the sieve segment, the sort order of the queries, and
+  * the joined runs.  Kept from batch to batch, so after the first few batches answering
+  * one allocates nothing but the result. */
+template <typename T>
+struct prime_batch_arena {
+	std::vector<uint64_t> words;
+	std::vector<std::size_t> order;
+	std::vector<std::pair<T, T>> runs;
+};
+
+/** Answers batches of queries [start, end] with end <= `len`.
+  *
+  * Each query on its own, as prime_sieve_list<T>::primes_range, costs a new
+  * std::vector<bool> and a division for every sieving prime to find its first multiple,
+  * which for a short range is most of the work.  Here the queries of a batch are sorted
+  * and merged into runs, joining two whenever the gap between them is at most
+  * `join_gap` (by default 16 times the number of sieving primes, below which sieving the
+  * gap is cheaper than finding the offsets again).  Each run is sieved in packed segments
+  * of about `segment_size` integers (by default filling the L1 data cache), into the
+  * calling thread's prime_batch_arena, and the primes are extracted a word at a time.
+  * Then each query's answer is found with two binary searches.
+  *
+  * For scattered queries finding the offsets is still the bulk of the work, so the
+  * constructor also stores floor((2^64-1)/p) for each sieving prime p, and the offsets
+  * are found with a multiplication instead of a (64-bit) division.
+  *
+  * query() is const and uses only thread local scratch space, so one object can serve
+  * any number of threads at once.
+  */
+template <typename T>
+class prime_batch_sieve {
+public:
+	prime_batch_sieve(const T len, const T join_gap = 0, const T segment_size = 0);
+	prime_batch_result<T> query(const std::vector<std::pair<T, T>> &queries)const;
+	void query(const std::vector<std::pair<T, T>> &queries, prime_batch_result<T> &result)const;
+	T max_end()const { return length; }
+private:
+	T length, gap;
+	uint64_t segment_bits;
+	std::vector<T> primes;
+	std::vector<uint64_t> reciprocals;     // reciprocals[i] = floor((2^64-1) / primes[i])
+	static prime_batch_arena<T>& arena();
+	void sieve_segment(T start, T bits, uint64_t *words)const;
+};
+
+/** Constructor: the sieving primes up to sqrt(len) */
+template <typename T>
+prime_batch_sieve<T>::prime_batch_sieve(const T len, const T join_gap, const T segment_size)
+	: length{len}, primes( small_prime_list<T>(integer_sqrt(len) + 1 < 3 ? 3 : integer_sqrt(len) + 1) )
+{
+	gap = ( join_gap == 0 ) ? static_cast<T>(16 * primes.size()) : join_gap;
+	reciprocals.resize(primes.size());
+	for (std::size_t i = 0; i < primes.size(); ++i) { reciprocals[i] = ~uint64_t(0) / primes[i]; }
+	segment_bits = ( segment_size == 0 ) ? default_stripe_size() / 2 : segment_size / 2;
+	segment_bits -= segment_bits % 64;
+	if ( segment_bits == 0 ) { segment_bits = 64; }
+}
+
+template <typename T>
+prime_batch_arena<T>& prime_batch_sieve<T>::arena()
+{
+	static thread_local prime_batch_arena<T> scratch;
+	return scratch;
+}
+
+/** As packed_sieve_segment(), with the remainders start % p found from the reciprocals:
+  * q = (start * reciprocal) >> 64 is floor(start/p) or one less, so one correction
+  * suffices. */
+template <typename T>
+void prime_batch_sieve<T>::sieve_segment(T start, T bits, uint64_t *words)const
+{
+	T end = packed_presieve_segment(start, bits, words);
+	T root = integer_sqrt(end);
+	for (std::size_t i = 1; i < primes.size(); ++i) {
+		T p = primes[i];
+		if ( p <= odd_presieve::largest_prime ) { continue; }
+		if ( p > root ) { break; }
+		T ps = p*p;
+		if ( ps < start ) {
+			uint64_t q = static_cast<uint64_t>((static_cast<unsigned __int128>(start) * reciprocals[i]) >> 64);
+			uint64_t r = start - q*p;
+			if ( r >= p ) { r -= p; }
+			ps = start + (r == 0 ? 0 : p - r);
+			if ( (ps%2)==0 ) { ps += p; } // ps smallest odd multiple of p greater than or equal to start
+		}
+		for (T j = (ps-start)/2; j < bits; j += p) {
+			words[j/64] &= ~(uint64_t(1) << (j%64));
+		}
+	}
+}
+
+template <typename T>
+prime_batch_result<T> prime_batch_sieve<T>::query(const std::vector<std::pair<T, T>> &queries)const
+{
+	prime_batch_result<T> result;
+	query(queries, result);
+	return result;
+}
+
+/** As above, reusing the memory of `result` (whose contents are replaced) */
+template <typename T>
+void prime_batch_sieve<T>::query(const std::vector<std::pair<T, T>> &queries, prime_batch_result<T> &result)const
+{
+	result.primes.clear();
+	result.ranges.assign(queries.size(), std::make_pair(std::size_t(0), std::size_t(0)));
+	prime_batch_arena<T> &scratch = arena();
+
+	// Sort the non-empty queries by start, and join them into runs
+	scratch.order.clear();
+	for (std::size_t i = 0; i < queries.size(); ++i) {
+		if ( queries[i].first <= queries[i].second and queries[i].first <= length ) { scratch.order.push_back(i); }
+	}
+	std::sort(scratch.order.begin(), scratch.order.end(), [&queries](std::size_t i, std::size_t j) {
+		return queries[i].first < queries[j].first;
+	});
+	scratch.runs.clear();
+	std::size_t reserve = 0;
+	for (auto i : scratch.order) {
+		T start = queries[i].first, end = std::min(queries[i].second, length);
+		if ( ! scratch.runs.empty() and ( start <= scratch.runs.back().second
+				or start - scratch.runs.back().second <= gap ) ) {
+			scratch.runs.back().second = std::max(scratch.runs.back().second, end);
+			continue;
+		}
+		if ( ! scratch.runs.empty() ) {
+			reserve += prime_count_upper_bound(scratch.runs.back().first, scratch.runs.back().second);
+		}
+		scratch.runs.push_back(std::make_pair(start, end));
+	}
+	if ( scratch.runs.empty() ) { return; }
+	reserve += prime_count_upper_bound(scratch.runs.back().first, scratch.runs.back().second);
+	result.primes.reserve(reserve);
+
+	// Sieve each run, a segment at a time
+	if ( scratch.words.size() < segment_bits / 64 ) { scratch.words.resize(segment_bits / 64); }
+	for (const auto &run : scratch.runs) {
+		if ( run.first <= 2 and 2 <= run.second ) { result.primes.push_back(2); }
+		uint64_t first = std::max<uint64_t>(run.first, 3);
+		first += 1 - first%2;
+		if ( first > run.second ) { continue; }
+		uint64_t total_bits = (run.second - first) / 2 + 1;
+		for (uint64_t b0 = 0; b0 < total_bits; b0 += segment_bits) {
+			T bits = static_cast<T>(std::min(segment_bits, total_bits - b0));
+			T start = static_cast<T>(first + 2*b0);
+			sieve_segment(start, bits, scratch.words.data());
+			extract_bits_pushback(scratch.words.data(), static_cast<std::size_t>(bits), start, T(2), result.primes);
+		}
+	}
+
+	// Each query's primes are a contiguous part of the list
+	for (auto i : scratch.order) {
+		auto lo = std::lower_bound(result.primes.begin(), result.primes.end(), queries[i].first);
+		auto hi = std::upper_bound(lo, result.primes.end(), std::min(queries[i].second, length));
+		result.ranges[i] = std::make_pair(static_cast<std::size_t>(lo - result.primes.begin()),
+			static_cast<std::size_t>(hi - result.primes.begin()));
+	}
+}
+
+/** The primes in each of the ranges [queries[i].first, queries[i].second], as one batch */
+template <typename T>
+prime_batch_result<T> prime_batch_query(const std::vector<std::pair<T, T>> &queries)
+{
+	T len = 0;
+	for (const auto &q : queries) { len = std::max(len, q.second); }
+	prime_batch_sieve<T> bs(len);
+	return bs.query(queries);
+}
+
+
+
+/** Various testing routines */
+/** Tests prime_batch_sieve against filtering prime_list, including from several threads */
+bool test29();
+
+
+#endif // __BATCH_QUERY_TPP
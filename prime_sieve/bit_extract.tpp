@@ -0,0 +1,280 @@
+/** @file: bit_extract.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Turning a sieve, stored as bits, into a list of primes a word at a time, instead of
+ *  a bit at a time.
+ */
+
+#ifndef __BIT_EXTRACT_TPP
+#define __BIT_EXTRACT_TPP
+
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+
+// --------------------------------------------------------------------------
+// Decoding single words
+// --------------------------------------------------------------------------
+
+/** Write value + step*i to `out` for each set bit i of `word`, in order, and return the
+  * number written.  Uses count trailing zeros and "clear lowest set bit", which with
+  * -march=native compile to the tzcnt and blsr instructions.
+  */
+template <typename T>
+inline std::size_t extract_word_scalar(uint64_t word, T value, T step, T *out)
+{
+	std::size_t n = 0;
+	while ( word != 0 ) {
+		out[n++] = value + step * static_cast<T>(__builtin_ctzll(word));
+		word &= word - 1;
+	}
+	return n;
+}
+
+#if defined(__AVX512F__)
+
+/** AVX-512 version: vpcompressd / vpcompressq pack the values for the set bits of each
+  * 16 (or 8) bits of the word into consecutive lanes, which are then stored in one go.
+  * May write up to 64 bytes past the last value.
+  */
+template <typename T>
+inline std::size_t extract_word_simd(uint64_t word, T value, T step, T *out)
+{
+	std::size_t n = 0;
+	if ( sizeof(T) == 4 ) {
+		const __m512i iota = _mm512_set_epi32(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+		__m512i vstep = _mm512_set1_epi32(static_cast<int>(step));
+		__m512i v = _mm512_add_epi32(_mm512_set1_epi32(static_cast<int>(value)), _mm512_mullo_epi32(iota, vstep));
+		__m512i next = _mm512_set1_epi32(static_cast<int>(16*step));
+		for (unsigned int j = 0; j < 4; ++j, word >>= 16) {
+			__mmask16 mask = static_cast<__mmask16>(word & 0xffff);
+			_mm512_storeu_si512(out + n, _mm512_maskz_compress_epi32(mask, v));
+			n += __builtin_popcount(mask);
+			v = _mm512_add_epi32(v, next);
+		}
+	} else {
+		const __m512i iota = _mm512_set_epi64(7,6,5,4,3,2,1,0);
+		__m512i vstep = _mm512_set1_epi64(static_cast<long long>(step));
+		__m512i v = _mm512_add_epi64(_mm512_set1_epi64(static_cast<long long>(value)), _mm512_mullox_epi64(iota, vstep));
+		__m512i next = _mm512_set1_epi64(static_cast<long long>(8*step));
+		for (unsigned int j = 0; j < 8; ++j, word >>= 8) {
+			__mmask8 mask = static_cast<__mmask8>(word & 0xff);
+			_mm512_storeu_si512(out + n, _mm512_maskz_compress_epi64(mask, v));
+			n += __builtin_popcount(mask);
+			v = _mm512_add_epi64(v, next);
+		}
+	}
+	return n;
+}
+
+#elif defined(__AVX2__)
+
+/** The positions of the set bits of each byte, padded with zeros; a compile time constant */
+struct byte_positions {
+	uint32_t pos[256][8];
+	constexpr byte_positions() : pos{} {
+		for (unsigned int b = 0; b < 256; ++b) {
+			unsigned int n = 0;
+			for (unsigned int i = 0; i < 8; ++i) {
+				if ( (b >> i) & 1 ) { pos[b][n++] = i; }
+			}
+			while ( n < 8 ) { pos[b][n++] = 0; }
+		}
+	}
+};
+
+inline const byte_positions& get_byte_positions()
+{
+	static constexpr byte_positions table{};
+	return table;
+}
+
+/** AVX2 version: for each byte of the word, load the positions of its set bits from a
+  * table, scale and offset them, and store all 8 lanes; then move on by the number of
+  * bits actually set.  May write up to 64 bytes past the last value.
+  */
+template <typename T>
+inline std::size_t extract_word_simd(uint64_t word, T value, T step, T *out)
+{
+	const byte_positions &table = get_byte_positions();
+	std::size_t n = 0;
+	if ( sizeof(T) == 4 ) {
+		__m256i vstep = _mm256_set1_epi32(static_cast<int>(step));
+		__m256i v = _mm256_set1_epi32(static_cast<int>(value));
+		__m256i next = _mm256_slli_epi32(vstep, 3);
+		for (unsigned int j = 0; j < 8; ++j, word >>= 8) {
+			unsigned int byte = word & 0xff;
+			__m256i pos = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(table.pos[byte]));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), _mm256_add_epi32(v, _mm256_mullo_epi32(pos, vstep)));
+			n += __builtin_popcount(byte);
+			v = _mm256_add_epi32(v, next);
+		}
+	} else {
+		// _mm256_mul_epu32 only sees the low 32 bits of each lane, so pos * step is made
+		// from pos * (low half of step) plus pos * (high half) shifted up
+		__m256i vstep = _mm256_set1_epi64x(static_cast<long long>(step));
+		__m256i vstep_hi = _mm256_srli_epi64(vstep, 32);
+		__m256i v = _mm256_set1_epi64x(static_cast<long long>(value));
+		__m256i next = _mm256_slli_epi64(vstep, 3);
+		auto times_step = [vstep, vstep_hi](__m256i x) {
+			return _mm256_add_epi64(_mm256_mul_epu32(x, vstep), _mm256_slli_epi64(_mm256_mul_epu32(x, vstep_hi), 32));
+		};
+		for (unsigned int j = 0; j < 8; ++j, word >>= 8) {
+			unsigned int byte = word & 0xff;
+			__m128i pos = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.pos[byte]));
+			__m256i lo = _mm256_cvtepu32_epi64(pos);
+			__m256i hi = _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table.pos[byte] + 4)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n), _mm256_add_epi64(v, times_step(lo)));
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + n + 4), _mm256_add_epi64(v, times_step(hi)));
+			n += __builtin_popcount(byte);
+			v = _mm256_add_epi64(v, next);
+		}
+	}
+	return n;
+}
+
+#endif
+
+
+
+
+// --------------------------------------------------------------------------
+// Decoding arrays of bits
+// --------------------------------------------------------------------------
+
+/** For each set bit i < nbits of the bit array at `bits` (bit i is bit i%8 of byte i/8,
+  * i.e. little-endian words of any size), append start + step*i to `vec`.
+  * The output is counted first with popcount, so `vec` is resized just once, to exactly
+  * the size needed, and then written to directly.  Uses AVX-512 or AVX2, if compiled for them, when T is a 32-bit
+  * or 64-bit integer; otherwise a word at a time with tzcnt and blsr.
+  */
+template <typename T>
+void extract_bits_pushback(const void *bits, std::size_t nbits, T start, T step, std::vector<T> &vec)
+{
+	const unsigned char *bytes = static_cast<const unsigned char*>(bits);
+	std::size_t nwords = nbits / 64;
+	auto load = [bytes,nbits,nwords](std::size_t w) {
+		uint64_t word = 0;
+		if ( w < nwords ) {
+			std::memcpy(&word, bytes + 8*w, 8);
+		} else {
+			// The last part word: only read the bytes which are there
+			std::size_t tail = nbits % 64;
+			std::memcpy(&word, bytes + 8*w, (tail + 7) / 8);
+			word &= ~uint64_t(0) >> (64 - tail);
+		}
+		return word;
+	};
+	std::size_t total_words = (nbits + 63) / 64;
+	std::size_t count = 0;
+	for (std::size_t w = 0; w < total_words; ++w) { count += __builtin_popcountll(load(w)); }
+	if ( count == 0 ) { return; }
+
+	std::size_t n = vec.size();
+	vec.resize(n + count);
+	T *out = vec.data() + n;
+	std::size_t w = 0;
+#if defined(__AVX512F__) || defined(__AVX2__)
+	if ( std::is_integral<T>::value and (sizeof(T) == 4 or sizeof(T) == 8) ) {
+		// The SIMD code writes whole vectors, so can only be used while there's room past
+		// the values for this word; this way the caller can reserve exactly what it needs.
+		const std::size_t slack = 64 / sizeof(T);
+		T *end = vec.data() + n + count;
+		for (; w < total_words; ++w) {
+			uint64_t word = load(w);
+			if ( static_cast<std::size_t>(end - out) < __builtin_popcountll(word) + slack ) { break; }
+			out += extract_word_simd(word, static_cast<T>(start + step * static_cast<T>(64*w)), step, out);
+		}
+	}
+#endif
+	for (; w < total_words; ++w) {
+		out += extract_word_scalar(load(w), static_cast<T>(start + step * static_cast<T>(64*w)), step, out);
+	}
+}
+
+/** The words storing the bits of a std::vector<bool>, laid out as extract_bits_pushback
+  * expects (bit i is bit i%8 of byte i/8), or nullptr if we can't see them.  This is the
+  * only code which depends on a standard library's internals: libstdc++ (gcc, including
+  * MinGW) keeps the bits in an array of unsigned long, from begin()._M_p at offset 0,
+  * which on a little-endian machine is that layout.  Define PRIME_SIEVE_PORTABLE_BOOL_VECTOR
+  * to never use it.
+  */
+inline const void* bool_vector_words(const std::vector<bool> &sieve)
+{
+#if defined(__GLIBCXX__) && !defined(PRIME_SIEVE_PORTABLE_BOOL_VECTOR) \
+	&& defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	if ( sieve.empty() ) { return nullptr; }
+	return static_cast<const void*>(sieve.begin()._M_p);
+#else
+	(void)sieve;
+	return nullptr;
+#endif
+}
+
+/** As above, for writing: the same words as uint64_t, or nullptr.  This also needs
+  * libstdc++'s unsigned long to be 64 bits, so that we write through the type it does. */
+inline uint64_t* bool_vector_words(std::vector<bool> &sieve)
+{
+#if defined(__SIZEOF_LONG__) && __SIZEOF_LONG__ == 8
+	return static_cast<uint64_t*>(const_cast<void*>(bool_vector_words(static_cast<const std::vector<bool>&>(sieve))));
+#else
+	(void)sieve;
+	return nullptr;
+#endif
+}
+
+/** As below, but using only the public interface of std::vector<bool>: the bits are
+  * packed into a buffer of words through the iterator, 64 to a word with no branches,
+  * and each buffer is decoded as usual.  This is the path for any other standard library.
+  */
+template <typename T>
+void extract_bits_pushback_portable(const std::vector<bool> &sieve, T start, T step, std::vector<T> &vec)
+{
+	const std::size_t buffer_words = 256;
+	uint64_t words[buffer_words];
+	auto it = sieve.begin();
+	for (std::size_t first = 0; first < sieve.size(); first += 64*buffer_words) {
+		std::size_t bits = std::min(sieve.size() - first, 64*buffer_words);
+		for (std::size_t w = 0; w < (bits + 63) / 64; ++w) {
+			std::size_t n = std::min<std::size_t>(64, bits - 64*w);
+			uint64_t word = 0;
+			for (std::size_t j = 0; j < n; ++j, ++it) { word |= uint64_t(*it) << j; }
+			words[w] = word;
+		}
+		extract_bits_pushback(static_cast<const void*>(words), bits,
+			static_cast<T>(start + step * static_cast<T>(first)), step, vec);
+	}
+}
+
+/** As above, from a std::vector<bool>: straight from its words if bool_vector_words()
+  * can find them, and otherwise with extract_bits_pushback_portable().
+  */
+template <typename T>
+void extract_bits_pushback(const std::vector<bool> &sieve, T start, T step, std::vector<T> &vec)
+{
+	const void *words = bool_vector_words(sieve);
+	if ( words != nullptr ) {
+		extract_bits_pushback(words, sieve.size(), start, step, vec);
+	} else {
+		extract_bits_pushback_portable(sieve, start, step, vec);
+	}
+}
+
+
+
+/** Various testing routines */
+/** Tests extract_bits_pushback against decoding one bit at a time */
+bool test15();
+
+
+#endif // __BIT_EXTRACT_TPP
@@ -0,0 +1,245 @@
+/** @file: bucket_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Segmented sieve for large (64-bit) ranges, where the sieving primes are kept in
+ *  "buckets" (after Tomás Oliveira e Silva) so each segment only looks at the primes
+ *  which actually hit it.
+ */
+
+#ifndef __BUCKET_SIEVE_TPP
+#define __BUCKET_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "cache_info.h"
+#include "packed_sieve.tpp"
+
+#include <vector>
+#include <cstdint>
+
+
+// --------------------------------------------------------------------------
+// class bucket_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** A large sieving prime, and where it next hits within its segment.  The prime is
+  * at most sqrt(end) so always fits into 32 bits, even for T = uint64_t.
+  */
+struct bucket_entry {
+	uint32_t prime;
+	uint32_t offset;
+};
+
+/** Segmented sieve of the odd numbers in [start, end], one segment at a time.
+  * Each segment holds `segment_size` integers, so segment_size/2 odd numbers, stored
+  * one bit each in a std::vector<uint64_t>: bit i is segment_start()+2i.
+  *
+  * Each segment starts as a copy of the odd_presieve pattern, which deals with the
+  * primes up to 17.  Other sieving primes p smaller than the number of bits in a segment
+  * hit every segment, and are kept in a list with the offset of their next multiple.
+  * Larger primes hit a segment at most once.  These are filed into a ring of
+  * "buckets", one for each of the next few segments, according to the segment of
+  * their next odd multiple.  Processing a segment then empties its bucket, crossing
+  * off one number per entry and re-filing the prime into the bucket of the segment it
+  * next hits.  So the cost per segment is proportional to the number of multiples
+  * crossed off, and not to the number of sieving primes.
+  *
+  * Sieving primes are themselves generated a chunk at a time, with a prime_sieve_list<T>
+  * of the primes up to end^(1/4), and only added once p*p reaches the current segment.
+  * Apart from the buckets, which are 8 bytes per sieving prime, memory use is small.
+  * Assumes end + 2*segment_size does not overflow T.
+  */
+template <typename T>
+class bucket_sieve {
+public:
+	bucket_sieve(T start, T end, T segment_size = 0);
+	bool next_segment();
+	T segment_start()const { return seg_start; }
+	bool is_prime(const T p)const;
+	void segment_primes_pushback(std::vector<T> &vec)const;
+	const std::vector<uint64_t>& get_segment()const { return segment; }
+private:
+	T start, end;
+	T bits;          // Odd numbers per segment; a multiple of 64
+	T seg_index;     // Number of the current segment
+	T seg_start;     // First (odd) number in the current segment
+	T seg_bits;      // Number of valid bits in the current segment
+	bool started;
+	std::vector<uint64_t> segment;
+	// Sieving primes smaller than `bits`, and the offset of their next odd multiple
+	// relative to the current segment (which can be beyond the end of the segment)
+	std::vector<T> smallprimes, smallnext;
+	std::vector<std::vector<bucket_entry>> buckets;
+	// Generating sieving primes
+	prime_sieve_list<T> base;
+	std::vector<T> pending;
+	typename std::vector<T>::size_type pending_pos;
+	T generated_to, sieve_limit;
+	bool next_sieving_prime(T &p);
+	void add_sieving_prime(T p);
+};
+
+template <typename T>
+bucket_sieve<T>::bucket_sieve(T s, T e, T segment_size)
+	: start{s}, end{e}, seg_index{0}, started{false},
+	base{integer_sqrt(integer_sqrt(e)) + 1}
+{
+	if ( segment_size == 0 ) { segment_size = default_stripe_size(); }
+	bits = segment_size / 2;
+	bits += (64 - bits%64) % 64;
+	if ( bits == 0 ) { bits = 64; }
+	segment.resize(bits/64);
+	start += 1 - (start%2); // Increase, if necessary, to make odd
+	seg_start = start;
+	// Largest step between segments a bucket entry can make is p/bits + 1 segments
+	sieve_limit = integer_sqrt(end);
+	buckets.resize(sieve_limit / bits + 2);
+	pending.assign(base.primes.begin(), base.primes.end());
+	pending_pos = 1; // Skip 2
+	generated_to = integer_sqrt(integer_sqrt(end)) + 1;
+}
+
+/** The next odd prime up to sqrt(end), or false if there are no more. */
+template <typename T>
+bool bucket_sieve<T>::next_sieving_prime(T &p)
+{
+	while ( pending_pos >= pending.size() ) {
+		if ( generated_to >= sieve_limit ) { return false; }
+		T chunk_end = generated_to + 2*bits;
+		if ( chunk_end > sieve_limit or chunk_end < generated_to ) { chunk_end = sieve_limit; }
+		pending = base.primes_range(generated_to + 1, chunk_end);
+		pending_pos = 0;
+		generated_to = chunk_end;
+	}
+	p = pending[pending_pos++];
+	return p <= sieve_limit;
+}
+
+/** File p according to its first odd multiple >= max(start, p*p).  This is only called
+  * once p*p is at most the end of the current segment, so the multiple is at most p
+  * segments ahead. */
+template <typename T>
+void bucket_sieve<T>::add_sieving_prime(T p)
+{
+	T m = p*p;
+	if ( m < seg_start ) {
+		T r = seg_start % p;
+		m = seg_start + (r == 0 ? 0 : p - r);
+		if ( (m%2) == 0 ) { m += p; }
+	}
+	if ( m > end or p <= odd_presieve::largest_prime ) { return; } // Small primes are pre-sieved
+	T g = (m - seg_start) / 2; // Offset from the current segment
+	if ( p < bits ) {
+		smallprimes.push_back(p);
+		smallnext.push_back(g);
+		return;
+	}
+	bucket_entry entry;
+	entry.prime = static_cast<uint32_t>(p);
+	entry.offset = static_cast<uint32_t>(g % bits);
+	buckets[ (seg_index + g / bits) % buckets.size() ].push_back(entry);
+}
+
+/** Compute the next segment; returns false once past `end`. */
+template <typename T>
+bool bucket_sieve<T>::next_segment()
+{
+	if ( started ) {
+		if ( end - seg_start < 2*bits ) { return false; }
+		seg_start += 2*bits;
+		++seg_index;
+	}
+	started = true;
+	if ( seg_start > end ) { return false; }
+	seg_bits = (end - seg_start) / 2 + 1;
+	if ( seg_bits > bits ) { seg_bits = bits; }
+	T seg_end = seg_start + 2*(seg_bits - 1);
+
+	// New sieving primes
+	T p;
+	while ( next_sieving_prime(p) ) {
+		if ( p > seg_end / p ) { --pending_pos; break; }
+		add_sieving_prime(p);
+	}
+
+	get_odd_presieve().fill(segment.data(), segment.size(), seg_start/2);
+	for (typename std::vector<T>::size_type i = 0; i < smallprimes.size(); ++i) {
+		T q = smallprimes[i], j = smallnext[i];
+		for (; j < bits; j += q) {
+			segment[j/64] &= ~(uint64_t(1) << (j%64));
+		}
+		smallnext[i] = j - bits;
+	}
+	auto &bucket = buckets[ seg_index % buckets.size() ];
+	for (const auto &entry : bucket) {
+		segment[entry.offset/64] &= ~(uint64_t(1) << (entry.offset%64));
+		T g = T(entry.offset) + entry.prime;
+		bucket_entry next;
+		next.prime = entry.prime;
+		next.offset = static_cast<uint32_t>(g % bits);
+		buckets[ (seg_index + g / bits) % buckets.size() ].push_back(next);
+	}
+	bucket.clear();
+
+	// Tidy up: the pre-sieve crossed off 3, ..., 17, 1 is not prime, and nothing past `end`
+	if ( seg_start <= odd_presieve::largest_prime ) {
+		for (T p : {3, 5, 7, 11, 13, 17}) {
+			if ( p >= seg_start and p <= seg_end ) {
+				segment[(p-seg_start)/2/64] |= uint64_t(1) << ((p-seg_start)/2%64);
+			}
+		}
+	}
+	if ( seg_start == 1 ) { segment[0] &= ~uint64_t(1); }
+	for (T j = seg_bits; j < bits and j%64 != 0; ++j) {
+		segment[j/64] &= ~(uint64_t(1) << (j%64));
+	}
+	for (T w = (seg_bits+63)/64; w < bits/64; ++w) { segment[w] = 0; }
+	return true;
+}
+
+/** Lookup in the current segment (so p must lie in it) */
+template <typename T>
+bool bucket_sieve<T>::is_prime(const T p)const
+{
+	if ( p==2 ) { return true; }
+	if ( (p%2)==0 or p < seg_start or (p - seg_start)/2 >= seg_bits ) { return false; }
+	T j = (p - seg_start) / 2;
+	return ( segment[j/64] >> (j%64) ) & 1;
+}
+
+/** Append the primes in the current segment to `vec` */
+template <typename T>
+void bucket_sieve<T>::segment_primes_pushback(std::vector<T> &vec)const
+{
+	extract_bits_pushback(segment.data(), 64*segment.size(), seg_start, T(2), vec);
+}
+
+
+
+
+// --------------------------------------------------------------------------
+
+/** List of primes in [start, end] using class bucket_sieve<T>.
+  */
+template <typename T>
+std::vector<T> prime_list_bucket(const T start, const T end, const T segment_size = 0)
+{
+	std::vector<T> primes;
+	primes.reserve(prime_count_upper_bound(start, end));
+	if ( start <= 2 and end >= 2 ) { primes.push_back(2); }
+	bucket_sieve<T> bs(start, end, segment_size);
+	while ( bs.next_segment() ) {
+		bs.segment_primes_pushback(primes);
+	}
+	return primes;
+}
+
+
+
+/** Various testing routines */
+/** Tests that prime_list_bucket agrees with prime_list and prime_sieve_list<T>::primes_range */
+bool test10();
+
+
+#endif // __BUCKET_SIEVE_TPP
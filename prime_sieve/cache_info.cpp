@@ -0,0 +1,170 @@
+/** @file: cache_info.cpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Finding the cache sizes of the machine we're running on, and using these to choose
+ *  a default stripe size.
+ */
+
+#include "cache_info.h"
+#include "sieve.tpp"
+#include "timer.tpp"
+
+#include <fstream>
+#include <sstream>
+#include <atomic>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+
+/** Parse sysfs sizes such as "32K" or "8192K" or "1M" */
+static unsigned int parse_size(const std::string &s)
+{
+	std::istringstream in(s);
+	unsigned int size = 0;
+	char unit = 0;
+	in >> size >> unit;
+	if ( unit == 'K' ) { size *= 1024; }
+	if ( unit == 'M' ) { size *= 1024*1024; }
+	return size;
+}
+
+static std::string read_line(const std::string &filename)
+{
+	std::ifstream file(filename);
+	std::string line;
+	std::getline(file, line);
+	return line;
+}
+
+/** Linux: /sys/devices/system/cpu/cpu0/cache/indexN/{level,type,size,coherency_line_size} */
+static void detect_sysfs(cache_geometry &cg)
+{
+	for (int index=0; index<16; ++index) {
+		std::string dir = "/sys/devices/system/cpu/cpu0/cache/index" + std::to_string(index) + "/";
+		std::string level = read_line(dir + "level");
+		if ( level.empty() ) { break; }
+		std::string type = read_line(dir + "type");
+		unsigned int size = parse_size(read_line(dir + "size"));
+		if ( level == "1" and type == "Data" and cg.l1d == 0 ) { cg.l1d = size; }
+		if ( level == "2" and type != "Instruction" and cg.l2 == 0 ) { cg.l2 = size; }
+		if ( level == "1" and type == "Data" and cg.line == 0 ) {
+			cg.line = parse_size(read_line(dir + "coherency_line_size"));
+		}
+	}
+}
+
+/** Intel leaf 4, or the AMD equivalent 0x8000001D, enumerate the caches; older AMD
+  * processors only have the summary leaves 0x80000005 and 0x80000006. */
+static void detect_cpuid(cache_geometry &cg)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	unsigned int eax, ebx, ecx, edx;
+	unsigned int maxext = __get_cpuid_max(0x80000000, nullptr);
+	unsigned int leaves[2] = { 4, 0x8000001D };
+	for (auto leaf : leaves) {
+		if ( leaf == 4 and __get_cpuid_max(0, nullptr) < 4 ) { continue; }
+		if ( leaf == 0x8000001D and maxext < 0x8000001D ) { continue; }
+		for (unsigned int sub=0; sub<16; ++sub) {
+			__cpuid_count(leaf, sub, eax, ebx, ecx, edx);
+			unsigned int type = eax & 0x1f; // 0 = no more caches, 1 = data, 2 = instruction, 3 = unified
+			if ( type == 0 ) { break; }
+			unsigned int level = (eax >> 5) & 0x7;
+			unsigned int line = (ebx & 0xfff) + 1;
+			unsigned int size = ((ebx >> 22) + 1) * (((ebx >> 12) & 0x3ff) + 1) * line * (ecx + 1);
+			if ( level == 1 and type == 1 and cg.l1d == 0 ) { cg.l1d = size; cg.line = line; }
+			if ( level == 2 and type != 2 and cg.l2 == 0 ) { cg.l2 = size; }
+		}
+	}
+	if ( cg.l1d == 0 and maxext >= 0x80000005 ) {
+		__cpuid(0x80000005, eax, ebx, ecx, edx);
+		cg.l1d = (ecx >> 24) * 1024;
+		cg.line = ecx & 0xff;
+	}
+	if ( cg.l2 == 0 and maxext >= 0x80000006 ) {
+		__cpuid(0x80000006, eax, ebx, ecx, edx);
+		cg.l2 = (ecx >> 16) * 1024;
+	}
+#endif
+}
+
+cache_geometry detect_cache_geometry()
+{
+	cache_geometry cg{0, 0, 0};
+	detect_sysfs(cg);
+	if ( cg.l1d == 0 or cg.l2 == 0 ) { detect_cpuid(cg); }
+	if ( cg.l1d == 0 ) { cg.l1d = 32*1024; }
+	if ( cg.l2 == 0 ) { cg.l2 = 256*1024; }
+	if ( cg.line == 0 ) { cg.line = 64; }
+	return cg;
+}
+
+const cache_geometry& cache_info()
+{
+	static const cache_geometry cg = detect_cache_geometry();
+	return cg;
+}
+
+/** Stripe size in bytes of sieve storage; zero until first used. */
+static std::atomic<unsigned int> stripe_bytes(0);
+
+unsigned int default_stripe_size(unsigned int integers_per_byte)
+{
+	unsigned int bytes = stripe_bytes.load();
+	if ( bytes == 0 ) { bytes = cache_info().l1d; }
+	return bytes * integers_per_byte;
+}
+
+unsigned int calibrate_stripe_size(const std::string &filename, bool force)
+{
+	const cache_geometry &cg = cache_info();
+	// File format is lines of "key value"
+	if ( !force ) {
+		std::ifstream file(filename);
+		std::string key;
+		unsigned int value, l1d = 0, l2 = 0, bytes = 0;
+		while ( file >> key >> value ) {
+			if ( key == "l1d" ) { l1d = value; }
+			if ( key == "l2" ) { l2 = value; }
+			if ( key == "stripe_bytes" ) { bytes = value; }
+		}
+		if ( bytes != 0 and l1d == cg.l1d and l2 == cg.l2 ) {
+			stripe_bytes = bytes;
+			return bytes * 16;
+		}
+	}
+
+	// Try from a quarter of L1 up to all of L2, with a sieve of 20 million
+	std::vector<unsigned int> candidates;
+	for (unsigned int bytes = cg.l1d / 4; bytes <= cg.l2; bytes *= 2) {
+		candidates.push_back(bytes);
+	}
+	candidates.push_back(cg.l1d * 3 / 4);
+	candidates.push_back(cg.l1d * 3 / 2);
+	unsigned int best = cg.l1d;
+	double besttime = 0;
+	for (auto bytes : candidates) {
+		unsigned int stripe = bytes * 16;
+		double t = 0;
+		for (int trial=0; trial<3; ++trial) {
+			double tt = timeit(1, [stripe]() { prime_list3<unsigned int>(20000000, stripe); });
+			if ( trial == 0 or tt < t ) { t = tt; }
+		}
+		if ( besttime == 0 or t < besttime ) {
+			besttime = t;
+			best = bytes;
+		}
+	}
+
+	std::ofstream file(filename, std::ios::out);
+	if ( file ) {
+		file << "l1d " << cg.l1d << "\n";
+		file << "l2 " << cg.l2 << "\n";
+		file << "stripe_bytes " << best << "\n";
+	}
+	stripe_bytes = best;
+	return best * 16;
+}
@@ -0,0 +1,43 @@
+/** @file: cache_info.h
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Finding the cache sizes of the machine we're running on, and using these to choose
+ *  a default stripe size.
+ */
+
+#ifndef __CACHE_INFO_H
+#define __CACHE_INFO_H
+
+#include <string>
+
+/** Sizes in bytes; zero means "unknown" */
+struct cache_geometry {
+	unsigned int l1d;
+	unsigned int l2;
+	unsigned int line;
+};
+
+/** Read the cache sizes of cpu0 from /sys/devices/system/cpu, falling back to the
+  * cpuid instruction, and then to 32KB / 256KB / 64 bytes if all else fails. */
+cache_geometry detect_cache_geometry();
+
+/** detect_cache_geometry(), worked out once at startup. */
+const cache_geometry& cache_info();
+
+/** Default stripe size, in integers, for a sieve using `integers_per_byte` integers per
+  * byte of storage (16 for the odds-only std::vector<bool>, 30 for class wheel_sieve).
+  * Initially this fills the L1 data cache; calibrate_stripe_size() can replace it. */
+unsigned int default_stripe_size(unsigned int integers_per_byte = 16);
+
+/** Load the best stripe size for this machine from `filename`, or if the file doesn't
+  * exist (or was written on a machine with different caches) time prime_list3 with a
+  * range of stripe sizes and save the fastest.  The result becomes the value returned
+  * by default_stripe_size(), and is returned in integers for the odds-only layout. */
+unsigned int calibrate_stripe_size(const std::string &filename, bool force = false);
+
+/** Various testing routines */
+/** Tests that the cache sizes are sensible, and that calibration is saved and reloaded */
+bool test9();
+
+#endif // __CACHE_INFO_H
@@ -0,0 +1,214 @@
+/** @file: gap_statistics.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Statistics of the gaps between primes, and counts of twin primes and other prime
+ *  k-tuples, read straight from the sieve, so that huge ranges can be studied without
+ *  ever making a list of primes.
+ */
+
+#ifndef __GAP_STATISTICS_TPP
+#define __GAP_STATISTICS_TPP
+
+
+#include "sieve.tpp"
+#include "packed_sieve.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+
+// --------------------------------------------------------------------------
+// struct prime_gap_statistics<T> code
+// --------------------------------------------------------------------------
+
+/** What gap_statistics() finds about the primes in a range.
+  * `record_gaps` holds (p, g) for each gap g from p to the next prime which is larger than
+  * every gap before it in the range, so the last one is the largest gap.  `tuple_counts[i]`
+  * is the number of p with p + o prime for every offset o in the i-th pattern.  Only gaps
+  * and tuples lying wholly inside the range are counted.
+  */
+template <typename T>
+struct prime_gap_statistics {
+	uint64_t count;                           // Number of primes
+	T first, last;                            // Smallest and largest prime, if count > 0
+	std::vector<uint64_t> gap_counts;         // gap_counts[g] is the number of gaps of g
+	std::vector<std::pair<T, T>> record_gaps;
+	std::vector<uint64_t> tuple_counts;
+	prime_gap_statistics(std::size_t tuples = 0)
+		: count{0}, first{0}, last{0}, tuple_counts(tuples, 0) { }
+	T max_gap()const { return record_gaps.empty() ? 0 : record_gaps.back().second; }
+	inline void add_prime(const T p);
+	void merge(const prime_gap_statistics &next);
+};
+
+/** Add the next prime, p, which is larger than `last` */
+template <typename T>
+inline void prime_gap_statistics<T>::add_prime(const T p)
+{
+	if ( count == 0 ) {
+		first = p;
+	} else {
+		T gap = p - last;
+		if ( gap >= gap_counts.size() ) { gap_counts.resize(gap + 1, 0); }
+		++gap_counts[gap];
+		if ( gap > max_gap() ) { record_gaps.push_back(std::make_pair(last, gap)); }
+	}
+	last = p;
+	++count;
+}
+
+/** Add in the statistics for the range immediately after ours (with the same patterns),
+  * which includes the gap from our last prime to its first. */
+template <typename T>
+void prime_gap_statistics<T>::merge(const prime_gap_statistics &next)
+{
+	for (std::size_t i = 0; i < tuple_counts.size() and i < next.tuple_counts.size(); ++i) {
+		tuple_counts[i] += next.tuple_counts[i];
+	}
+	if ( next.count == 0 ) { return; }
+	uint64_t before = count;
+	add_prime(next.first);
+	count = before + next.count;
+	last = next.last;
+	if ( gap_counts.size() < next.gap_counts.size() ) { gap_counts.resize(next.gap_counts.size(), 0); }
+	for (std::size_t g = 0; g < next.gap_counts.size(); ++g) { gap_counts[g] += next.gap_counts[g]; }
+	for (const auto &r : next.record_gaps) {
+		if ( r.second > max_gap() ) { record_gaps.push_back(r); }
+	}
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// gap_statistics code
+// --------------------------------------------------------------------------
+
+/** Twin, cousin and sexy primes, the two forms of prime triplet, and prime quadruplets,
+  * as offsets from the smallest member */
+template <typename T>
+std::vector<std::vector<T>> prime_tuple_patterns()
+{
+	return { {0, 2}, {0, 4}, {0, 6}, {0, 2, 6}, {0, 4, 6}, {0, 2, 6, 8} };
+}
+
+/** Gaps and tuples for one segment: the odd numbers start, start+2, ..., with `bits` of
+  * them belonging to the segment, and the rest of `words` (zero past the end of the whole
+  * range) there so that tuples can look past the end of the segment. */
+template <typename T>
+void gap_statistics_segment(const uint64_t *words, T start, std::size_t bits,
+	const std::vector<std::vector<std::size_t>> &shifts, prime_gap_statistics<T> &stats)
+{
+	std::size_t nwords = (bits + 63) / 64;
+	uint64_t last_mask = ( bits%64 == 0 ) ? ~uint64_t(0) : ~uint64_t(0) >> (64 - bits%64);
+	for (std::size_t w = 0; w < nwords; ++w) {
+		uint64_t word = words[w];
+		if ( w == nwords-1 ) { word &= last_mask; }
+		T value = start + static_cast<T>(128*w);
+		while ( word != 0 ) {
+			stats.add_prime(value + 2*static_cast<T>(__builtin_ctzll(word)));
+			word &= word - 1;
+		}
+	}
+	// Bit i of the tuple mask is set if every start + 2i + offset is prime
+	for (std::size_t t = 0; t < shifts.size(); ++t) {
+		uint64_t total = 0;
+		for (std::size_t w = 0; w < nwords; ++w) {
+			uint64_t m = words[w];
+			for (auto s : shifts[t]) {
+				std::size_t q = w + s/64, r = s%64;
+				m &= ( r == 0 ) ? words[q] : (words[q] >> r) | (words[q+1] << (64 - r));
+			}
+			if ( w == nwords-1 ) { m &= last_mask; }
+			total += __builtin_popcountll(m);
+		}
+		stats.tuple_counts[t] += total;
+	}
+}
+
+/** Statistics for the primes in [start, end], using `threads` threads (0 means
+  * std::thread::hardware_concurrency()).  `patterns` lists the k-tuples to count, as even
+  * offsets from the smallest member, which must be odd.
+  *
+  * The odd numbers are sieved in packed segments of about `segment_size` integers (by
+  * default filling the L1 data cache) with packed_sieve_segment().  The gaps come from
+  * walking the set bits, and each tuple is counted by and-ing the words with copies of
+  * themselves shifted by the offsets and counting the bits left.  Each segment sieves a
+  * little past its end, so tuples which start in it but finish in the next are counted.
+  * Runs of segments are shared out between the threads; each run's statistics start
+  * afresh, and merge() then joins them up in order, adding the gaps across the joins.
+  */
+template <typename T>
+prime_gap_statistics<T> gap_statistics(T start, T end,
+	const std::vector<std::vector<T>> &patterns = prime_tuple_patterns<T>(),
+	unsigned int threads = 1, T segment_size = 0)
+{
+	prime_gap_statistics<T> stats(patterns.size());
+	if ( end < start or end < 2 ) { return stats; }
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	if ( start <= 2 ) { stats.add_prime(2); }
+	uint64_t lo = std::max<uint64_t>(start, 3);
+	lo += 1 - lo%2;
+	if ( lo > end ) { return stats; }
+
+	// Segment k is the odd numbers from lo + 2*k*bits; each sieves tail_words more words
+	uint64_t total_bits = (end - lo) / 2 + 1;
+	uint64_t bits = ( segment_size == 0 ) ? default_stripe_size() / 2 : segment_size / 2;
+	bits -= bits % 64;
+	if ( bits == 0 ) { bits = 64; }
+	if ( bits > total_bits ) { bits = total_bits + 63 - (total_bits + 63) % 64; }
+	std::vector<std::vector<std::size_t>> shifts(patterns.size());
+	std::size_t max_shift = 0;
+	for (std::size_t t = 0; t < patterns.size(); ++t) {
+		for (auto o : patterns[t]) {
+			if ( o == 0 ) { continue; }
+			shifts[t].push_back(static_cast<std::size_t>(o / 2));
+			max_shift = std::max(max_shift, static_cast<std::size_t>(o / 2));
+		}
+	}
+	std::size_t tail_words = (max_shift + 63) / 64;
+	std::vector<T> primes = small_prime_list<T>(integer_sqrt(end) + 1);
+
+	uint64_t numsegs = (total_bits + bits - 1) / bits;
+	uint64_t numchunks = ( threads == 1 ) ? 1 : std::min<uint64_t>(numsegs, 8*threads);
+	std::vector<prime_gap_statistics<T>> results(numchunks, prime_gap_statistics<T>(patterns.size()));
+	std::atomic<uint64_t> next_chunk(0);
+	auto work = [&]() {
+		std::vector<uint64_t> words(bits/64 + tail_words + 1);
+		uint64_t c;
+		while ( (c = next_chunk++) < numchunks ) {
+			for (uint64_t k = numsegs * c / numchunks; k < numsegs * (c+1) / numchunks; ++k) {
+				uint64_t first_bit = k * bits;
+				uint64_t b = std::min(bits, total_bits - first_bit);
+				uint64_t sieve_bits = std::min(b + 64*tail_words, total_bits - first_bit);
+				T seg_start = static_cast<T>(lo + 2*first_bit);
+				std::fill(words.begin(), words.end(), 0);
+				packed_sieve_segment(primes, seg_start, static_cast<T>(sieve_bits), words.data());
+				gap_statistics_segment(words.data(), seg_start, static_cast<std::size_t>(b), shifts, results[c]);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) { workers.push_back(std::thread(work)); }
+	work();
+	for (auto &w : workers) { w.join(); }
+	for (const auto &r : results) { stats.merge(r); }
+	return stats;
+}
+
+
+
+/** Various testing routines */
+/** Tests gap_statistics against prime_list */
+bool test25();
+
+
+#endif // __GAP_STATISTICS_TPP
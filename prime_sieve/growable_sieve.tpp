@@ -0,0 +1,173 @@
+/** @file: growable_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  A sieve with no fixed length, which extends itself as larger numbers are asked about,
+ *  without recomputing anything it already has.
+ */
+
+#ifndef __GROWABLE_SIEVE_TPP
+#define __GROWABLE_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "packed_sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+
+
+// --------------------------------------------------------------------------
+// class growable_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Odds-only sieve, packed into 64-bit words as in packed_sieve.tpp (bit i is 2i+1), which
+  * covers [0, limit()] and grows on demand.
+  *
+  * extend(len) sieves just the new segments, in order, with packed_sieve_segment(), so
+  * nothing is ever sieved twice.  The sieving primes are only extended as far as the new
+  * segments need: from the compile time table below 2^16, and after that by reading them
+  * out of the sieve itself (first extending up to their square root, if need be).
+  * The storage grows by doubling its capacity, so the cost of copying on growth is
+  * amortised; the sieving is done a segment at a time, only as far as is asked for,
+  * which keeps the cost of each call in proportion to how far the limit moves.
+  */
+template <typename T>
+class growable_sieve {
+public:
+	growable_sieve(const T len = 0, const T segment_size = 0);
+	void extend(const T len);
+	T limit()const { return covered; }
+	bool is_prime(const T p);
+	std::vector<T> primes_range(T start, T end);
+	uint64_t sieved_words()const { return sieved; }
+private:
+	std::vector<uint64_t> words;
+	std::vector<T> base;   // All the primes up to base_limit, starting with 2
+	T base_limit;
+	T covered;             // The sieve is complete for [0, covered]
+	T segment_bits;
+	uint64_t sieved;       // Total number of words ever sieved
+	void extend_base(const T bound);
+	void sieve_segment(T bits);
+	void append_primes(std::size_t first, std::size_t last, std::vector<T> &vec)const;
+};
+
+/** Constructor: sieves up to at least `len`.  Segments have `segment_size` integers, by
+  * default filling the L1 data cache, and at most 2^32. */
+template <typename T>
+growable_sieve<T>::growable_sieve(const T len, const T segment_size)
+	: base_limit{0}, covered{0}, sieved{0}
+{
+	T size = ( segment_size == 0 ) ? default_stripe_size() : segment_size;
+	segment_bits = size / 2;
+	segment_bits -= segment_bits % 64;
+	if ( segment_bits == 0 ) { segment_bits = 64; }
+	// So the sieving primes for a segment are always below 2^16 or already in the sieve
+	if ( static_cast<uint64_t>(segment_bits) > (uint64_t(1) << 31) ) { segment_bits = static_cast<T>(uint64_t(1) << 31); }
+	extend(len);
+}
+
+/** Make sure the sieve covers [0, len].  Sieves whole segments, the last possibly only
+  * part done, up to the end of the range of T. */
+template <typename T>
+void growable_sieve<T>::extend(const T len)
+{
+	while ( covered < len or words.empty() ) {
+		if ( covered == std::numeric_limits<T>::max() ) { return; }
+		// Next segment starts at 128*words.size()+1, i.e. at a word boundary
+		T start = static_cast<T>(128 * words.size() + 1);
+		T bits = segment_bits;
+		T room = (std::numeric_limits<T>::max() - start) / 2 + 1;
+		if ( bits > room ) { bits = room - room%64; }
+		if ( bits == 0 ) { return; }
+		T end = start + 2*(bits-1);
+		extend_base(integer_sqrt(end));
+		sieve_segment(bits);
+		covered = ( end == std::numeric_limits<T>::max() ) ? end : end + 1;
+	}
+}
+
+/** Sieve the next `bits` odd numbers onto the end of the sieve */
+template <typename T>
+void growable_sieve<T>::sieve_segment(T bits)
+{
+	std::size_t w = words.size();
+	std::size_t nwords = static_cast<std::size_t>(bits) / 64;
+	if ( words.capacity() < w + nwords ) { words.reserve(2 * (w + nwords)); }
+	words.resize(w + nwords);
+	packed_sieve_segment(base, static_cast<T>(128*w + 1), bits, words.data() + w);
+	sieved += nwords;
+}
+
+/** Make sure `base` holds all the primes up to `bound` */
+template <typename T>
+void growable_sieve<T>::extend_base(const T bound)
+{
+	if ( base_limit >= bound ) { return; }
+	if ( bound < small_prime_limit ) {
+		base = small_prime_list<T>(bound < 3 ? 3 : bound);
+	} else {
+		extend(bound);
+		// Odd numbers in (base_limit, bound]; base_limit is at least 3
+		append_primes(static_cast<std::size_t>((base_limit + 1) / 2), static_cast<std::size_t>((bound - 1) / 2), base);
+	}
+	base_limit = bound;
+}
+
+/** Append the primes for bits first to last (inclusive) of the sieve, which must be computed */
+template <typename T>
+void growable_sieve<T>::append_primes(std::size_t first, std::size_t last, std::vector<T> &vec)const
+{
+	if ( first > last ) { return; }
+	// The first word, without the bits before `first`
+	std::size_t w = first / 64;
+	uint64_t word = words[w] & (~uint64_t(0) << (first % 64));
+	if ( last / 64 == w ) { word &= ~uint64_t(0) >> (63 - last % 64); }
+	T value = static_cast<T>(128*w + 1);
+	std::size_t n = vec.size();
+	vec.resize(n + __builtin_popcountll(word));
+	extract_word_scalar(word, value, T(2), vec.data() + n);
+	if ( last / 64 > w ) {
+		extract_bits_pushback(words.data() + w + 1, last + 1 - 64*(w+1), static_cast<T>(value + 128), T(2), vec);
+	}
+}
+
+/** Is p prime?  Extends the sieve if necessary. */
+template <typename T>
+bool growable_sieve<T>::is_prime(const T p)
+{
+	if ( p==2 ) { return true; }
+	if ( p<=1 or (p%2)==0 ) { return false; }
+	extend(p);
+	return ( words[p/128] >> ((p/2)%64) ) & 1;
+}
+
+/** The primes in [start, end], extending the sieve if necessary. */
+template <typename T>
+std::vector<T> growable_sieve<T>::primes_range(T start, T end)
+{
+	std::vector<T> primes;
+	if ( end < start or end < 2 ) { return primes; }
+	extend(end);
+	primes.reserve(prime_count_upper_bound(start, end));
+	if ( start <= 2 ) { primes.push_back(2); }
+	if ( start < 3 ) { start = 3; }
+	start += 1 - (start%2);
+	if ( start > end ) { return primes; }
+	append_primes(static_cast<std::size_t>(start / 2), static_cast<std::size_t>((end - 1) / 2), primes);
+	return primes;
+}
+
+
+
+/** Various testing routines */
+/** Tests that growable_sieve agrees with prime_list as it grows, and never sieves twice */
+bool test20();
+
+
+#endif // __GROWABLE_SIEVE_TPP
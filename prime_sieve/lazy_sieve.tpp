@@ -0,0 +1,161 @@
+/** @file: lazy_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  A sieve for answering is_prime() from many threads at once, which only computes the
+ *  segments which are actually asked about, the first time they are asked about.
+ */
+
+#ifndef __LAZY_SIEVE_TPP
+#define __LAZY_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "packed_sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+
+
+// --------------------------------------------------------------------------
+// class lazy_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Odds-only sieve of [0, len], packed into 64-bit words as in packed_sieve.tpp, split
+  * into segments of a fixed number of words.  The constructor only finds the primes up to
+  * sqrt(len); each segment is allocated and sieved, with packed_sieve_segment(), the first
+  * time a query lands in it.
+  *
+  * All the member functions may be called from any number of threads at once.  Each
+  * segment has a std::once_flag, so it is computed exactly once, and threads asking for
+  * it meanwhile wait for that to finish; it is then published through an atomic pointer.
+  * Once a segment is published, reading it is one acquire load and no locking at all.
+  */
+template <typename T>
+class lazy_sieve {
+public:
+	lazy_sieve(const T len, const T segment_size = 0);
+	bool is_prime(const T p)const;
+	std::vector<T> primes_range(T start, T end)const;
+	T limit()const { return length; }
+	std::size_t segments()const { return num_segments; }
+	std::size_t segments_computed()const { return computed.load(std::memory_order_relaxed); }
+private:
+	lazy_sieve(const lazy_sieve&);
+	lazy_sieve& operator=(const lazy_sieve&);
+	T length;
+	std::vector<T> primes;  // Sieving primes, up to sqrt(length)
+	std::size_t segment_words, num_segments;
+	mutable std::unique_ptr<std::atomic<const uint64_t*>[]> published;
+	mutable std::unique_ptr<std::once_flag[]> once;
+	mutable std::unique_ptr<std::unique_ptr<uint64_t[]>[]> storage;
+	mutable std::atomic<std::size_t> computed;
+	const uint64_t* segment(std::size_t k)const;
+	void compute_segment(std::size_t k)const;
+};
+
+/** Constructor: finds the sieving primes and sets up the (empty) segments.  A segment has
+  * about `segment_size` integers, by default enough to fill the L1 data cache. */
+template <typename T>
+lazy_sieve<T>::lazy_sieve(const T len, const T segment_size)
+	: length{len}, computed{0}
+{
+	primes = small_prime_list<T>(integer_sqrt(len) + 1);
+	T size = ( segment_size == 0 ) ? default_stripe_size() : segment_size;
+	segment_words = static_cast<std::size_t>(size / 128);
+	if ( segment_words == 0 ) { segment_words = 1; }
+	std::size_t total_words = static_cast<std::size_t>(len / 128) + 1;
+	num_segments = (total_words + segment_words - 1) / segment_words;
+	published.reset(new std::atomic<const uint64_t*>[num_segments]);
+	once.reset(new std::once_flag[num_segments]);
+	storage.reset(new std::unique_ptr<uint64_t[]>[num_segments]);
+	for (std::size_t k = 0; k < num_segments; ++k) {
+		published[k].store(nullptr, std::memory_order_relaxed);
+	}
+}
+
+/** Segment k, computing it if no thread has yet. */
+template <typename T>
+inline const uint64_t* lazy_sieve<T>::segment(std::size_t k)const
+{
+	const uint64_t *words = published[k].load(std::memory_order_acquire);
+	if ( words != nullptr ) { return words; }
+	std::call_once(once[k], &lazy_sieve<T>::compute_segment, this, k);
+	return published[k].load(std::memory_order_acquire);
+}
+
+/** Only ever called once for each k, by std::call_once */
+template <typename T>
+void lazy_sieve<T>::compute_segment(std::size_t k)const
+{
+	// Segment k is the odd numbers from 128*segment_words*k + 1, up to length
+	uint64_t first_bit = static_cast<uint64_t>(segment_words) * 64 * k;
+	uint64_t last_bit = (static_cast<uint64_t>(length) - 1) / 2; // length is at least 3 here
+	if ( last_bit >= first_bit + 64*segment_words ) { last_bit = first_bit + 64*segment_words - 1; }
+	T bits = static_cast<T>(last_bit - first_bit + 1);
+	std::unique_ptr<uint64_t[]> words(new uint64_t[segment_words]());
+	packed_sieve_segment(primes, static_cast<T>(2*first_bit + 1), bits, words.get());
+	const uint64_t *ptr = words.get();
+	storage[k] = std::move(words);
+	published[k].store(ptr, std::memory_order_release);
+	computed.fetch_add(1, std::memory_order_relaxed);
+}
+
+template <typename T>
+bool lazy_sieve<T>::is_prime(const T p)const
+{
+	if ( p==2 ) { return length >= 2; }
+	if ( p<=1 or (p%2)==0 or p>length ) { return false; }
+	std::size_t bit = static_cast<std::size_t>(p/2);
+	const uint64_t *words = segment(bit / (64*segment_words));
+	bit %= 64*segment_words;
+	return ( words[bit/64] >> (bit%64) ) & 1;
+}
+
+/** The primes in [start, end] (up to the limit), computing any segments needed. */
+template <typename T>
+std::vector<T> lazy_sieve<T>::primes_range(T start, T end)const
+{
+	std::vector<T> result;
+	if ( end > length ) { end = length; }
+	if ( end < start or end < 2 ) { return result; }
+	result.reserve(prime_count_upper_bound(start, end));
+	if ( start <= 2 ) { result.push_back(2); }
+	if ( start < 3 ) { start = 3; }
+	start += 1 - (start%2);
+	if ( start > end ) { return result; }
+	std::size_t first = static_cast<std::size_t>(start/2), last = static_cast<std::size_t>((end-1)/2);
+	std::size_t seg_bits = 64*segment_words;
+	for (std::size_t k = first / seg_bits; k <= last / seg_bits; ++k) {
+		const uint64_t *words = segment(k);
+		std::size_t lo = ( k == first / seg_bits ) ? first % seg_bits : 0;
+		std::size_t hi = ( k == last / seg_bits ) ? last % seg_bits : seg_bits - 1;
+		// The first word, without the bits before lo; then whole words
+		std::size_t w = lo / 64;
+		uint64_t word = words[w] & (~uint64_t(0) << (lo % 64));
+		if ( hi / 64 == w ) { word &= ~uint64_t(0) >> (63 - hi % 64); }
+		T value = static_cast<T>(2*(k*seg_bits + 64*w) + 1);
+		std::size_t n = result.size();
+		result.resize(n + __builtin_popcountll(word));
+		extract_word_scalar(word, value, T(2), result.data() + n);
+		if ( hi / 64 > w ) {
+			extract_bits_pushback(words + w + 1, hi + 1 - 64*(w+1), static_cast<T>(value + 128), T(2), result);
+		}
+	}
+	return result;
+}
+
+
+
+/** Various testing routines */
+/** Tests lazy_sieve from several threads at once against prime_list */
+bool test21();
+
+
+#endif // __LAZY_SIEVE_TPP
@@ -7,6 +7,7 @@
 
 #include "sieve_time.h"
 #include "timer.tpp"
+#include "prime_table.h"
 
 #include <iostream>
 using std::cout;
@@ -22,26 +23,52 @@ bool tests()
 	if ( ! test4() ) { return false; }
 	if ( ! test5() ) { return false; }
 	if ( ! test6() ) { return false; }
+	if ( ! test7() ) { return false; }
+	if ( ! test8() ) { return false; }
+	if ( ! test9() ) { return false; }
+	if ( ! test10() ) { return false; }
+	if ( ! test11() ) { return false; }
+	if ( ! test12() ) { return false; }
+	if ( ! test13() ) { return false; }
+	if ( ! test14() ) { return false; }
+	if ( ! test15() ) { return false; }
+	if ( ! test16() ) { return false; }
+	if ( ! test17() ) { return false; }
+	if ( ! test18() ) { return false; }
+	if ( ! test19() ) { return false; }
+	if ( ! test20() ) { return false; }
+	if ( ! test21() ) { return false; }
+	if ( ! test22() ) { return false; }
+	if ( ! test23() ) { return false; }
+	if ( ! test24() ) { return false; }
+	if ( ! test25() ) { return false; }
+	if ( ! test26() ) { return false; }
+	if ( ! test27() ) { return false; }
+	if ( ! test28() ) { return false; }
+	if ( ! test29() ) { return false; }
+	if ( ! test30() ) { return false; }
 	if ( ! test_dotime7() ) { return false; }
 	if ( ! test_dotime6a7() ) { return false; }
+	if ( ! test_dotime8() ) { return false; }
 	return true;
 }
 
-/** Save out the first billion primes.  This is a little slow, and takes 1/2GB of disk space. */
+/** Save out the primes below a billion.  As a binary table (see prime_table.h) this takes
+ *  about 32MB of disk space, and reading it back is just a memory map. */
 void show_off()
 {
-	cout << "Primes below 1,000,000,000: ";
-	auto pl = prime_list2<unsigned int>(1000000000,512000);
-	cout << pl.size() << endl;
-	cout << "Writing to file..." << endl;
-	std::ofstream file("primes.txt", std::ios::out);
-	if ( !file ) {
-		cout << "Can't open 'primes.txt' for writing..." << endl;
+	cout << "Writing primes below 1,000,000,000 to file..." << endl;
+	if ( ! write_prime_table("primes.bin", 1000000000) ) {
+		cout << "Can't open 'primes.bin' for writing..." << endl;
 		return;
 	}
-	for (const auto x : pl) {
-		file << x << endl;
+	prime_table table;
+	if ( ! table.open("primes.bin") ) {
+		cout << "Can't read back 'primes.bin'..." << endl;
+		return;
 	}
+	cout << "Primes below 1,000,000,000: " << table.size() << endl;
+	cout << "The 50,000,000th prime: " << table.nth_prime(50000000) << endl;
 }
 
 void time1()
@@ -115,6 +142,8 @@ void time5()
 		auto func = [ss]() { dotime4(100000000,ss*1024); };
 		cout << ss*1024/16 << " : " << timeit(3, func) << endl;
 	}
+	auto func = []() { dotime4(100000000,default_stripe_size()); };
+	cout << "Default " << default_stripe_size()/16 << " : " << timeit(3, func) << endl;
 }
 
 /** Fastest seems to occur at 32KB usage, which is indeed the L1 data cache on my i5.
@@ -128,6 +157,8 @@ void time5a()
 		auto func = [ss]() { dotime4(1000000000,ss*1024); };
 		cout << ss*1024/16 << " : " << timeit(1, func) << endl;
 	}
+	auto autofunc = []() { dotime4(1000000000,default_stripe_size()); };
+	cout << "Default " << default_stripe_size()/16 << " : " << timeit(1, autofunc) << endl;
 	auto func = []() { dotime3(1000000000); };
 	cout << "One block : " << timeit(1, func) << endl;
 }
@@ -211,6 +242,54 @@ void time7()
 	}
 }
 
+/** Finding the sieve with the mod 30 wheel, compared to sieve_stripe.
+ *  A stripe of 512000 uses 32000 bytes of std::vector<bool>; the same memory in
+ *  class wheel_sieve covers 960000 integers.
+ */
+void time7a()
+{
+	cout << "Timings for sieve_stripe<unsigned int>, just the sieve, stripe size 512000:" << endl;
+	unsigned int size = 100, loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime6a(size,512000); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	{
+		size = 4000000000;
+		auto func = [size]() { dotime6a(size,512000); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+	}
+	cout << endl;
+	cout << "Timings for wheel_sieve<unsigned int>, just the sieve, stripe size 960000:" << endl;
+	size = 100; loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime6c(size,960000); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	{
+		size = 4000000000;
+		auto func = [size]() { dotime6c(size,960000); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+	}
+	cout << endl;
+	cout << "Timings for wheel_sieve<unsigned int>, prime list, stripe size 960000:" << endl;
+	size = 100; loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime6d(size,960000); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	cout << endl;
+}
+
 /** Finding the sieve, with 2 threads */
 void time8()
 {
@@ -271,11 +350,460 @@ void time8a()
 		auto func = [ss]() { dotime7(1000000000,ss*1024,true); };
 		cout << ss*1024/16 << " : " << timeit(1, func) << endl;
 	}
+	auto func = []() { dotime7(1000000000,default_stripe_size(),true); };
+	cout << "Default " << default_stripe_size()/16 << " : " << timeit(1, func) << endl;
+}
+
+/** Finding the sieve with work stealing, for increasing numbers of threads */
+void time8b()
+{
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "Timings for sieve_stripe<unsigned int> with parallel_compute, size 1,000,000,000, stripe size 512000:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		parallel_sieve_report report;
+		auto func = [threads,&report]() { dotime8(1000000000,512000,threads,&report); };
+		cout << threads << " : " << timeit(1, func) << "  segments per thread (stolen):";
+		for (unsigned int i=0; i<threads; ++i) {
+			cout << " " << report.segments[i] << " (" << report.stolen[i] << ")";
+		}
+		cout << endl;
+	}
+	cout << "Timings for wheel_sieve<unsigned int> with parallel_compute, size 4,000,000,000, stripe size 960000:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime8a(4000000000u,960000,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+}
+
+/** Primes in a window of 100,000,000 at increasingly large starting points */
+void time9()
+{
+	cout << "Primes in [start, start+100,000,000] with prime_sieve_list<uint64_t> and bucket_sieve<uint64_t>:" << endl;
+	uint64_t start = 1000000000000ull;
+	while ( start <= 1000000000000000000ull ) {
+		auto func = [start]() { dotime9(start,100000000,default_stripe_size()); };
+		cout << start << " : bucket_sieve " << timeit(1, func);
+		if ( start <= 100000000000000ull ) {
+			auto func = [start]() { dotime9a(start,100000000,default_stripe_size()); };
+			cout << "  prime_sieve_list " << timeit(1, func);
+		}
+		cout << endl;
+		start *= 100;
+	}
+}
+
+/** Walking over the primes with prime_range, compared to making the list */
+void time10()
+{
+	cout << "Timings for summing the primes from prime_range<unsigned int>:" << endl;
+	unsigned int size = 100, loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime10(size); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	cout << endl;
+	cout << "Compare to prime_list2<unsigned int> with the default stripe size:" << endl;
+	size = 100; loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime4(size,default_stripe_size()); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	cout << endl;
+}
+
+/** Counting primes with count_primes, compared to the size of the list from prime_list2 */
+void time11()
+{
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "Timings for count_primes<unsigned int>:" << endl;
+	unsigned int size = 100, loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime11(size,1); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	{
+		size = 4000000000;
+		auto func = [size]() { dotime11(size,1); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+	}
+	cout << endl;
+	cout << "count_primes<unsigned int>(0, 4,000,000,000) with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime11(4000000000u,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+	cout << "Compare to prime_list2<unsigned int>(...).size() with the default stripe size:" << endl;
+	size = 100; loops = 2000000;
+	while ( size <= 1000000000 ) {
+		auto func = [size]() { dotime4(size,default_stripe_size()).size(); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	cout << endl;
+}
+
+/** Writing and memory mapping a binary prime table, and looking things up in it */
+void time12()
+{
+	auto write = []() { write_prime_table("primes.bin", 1000000000); };
+	cout << "Writing primes below 1,000,000,000 to 'primes.bin' : " << timeit(1, write) << endl;
+	auto open = []() { prime_table table; table.open("primes.bin"); };
+	cout << "Opening 'primes.bin' : " << timeit(100, open) << endl;
+	prime_table table;
+	table.open("primes.bin");
+	auto lookups = [&table]() {
+		uint64_t n = 12345, found = 0;
+		for (int i=0; i<1000000; ++i) {
+			n = (n * 1103515245 + 12345) % 1000000000;
+			found += table.is_prime(n);
+		}
+		return found;
+	};
+	cout << "1,000,000 calls to is_prime : " << timeit(1, lookups) << endl;
+	auto nth = [&table]() {
+		uint64_t k = 12345, sum = 0;
+		for (int i=0; i<1000000; ++i) {
+			k = (k * 1103515245 + 12345) % table.size() + 1;
+			sum += table.nth_prime(k);
+		}
+		return sum;
+	};
+	cout << "1,000,000 calls to nth_prime : " << timeit(1, nth) << endl;
+	auto walk = [&table]() {
+		uint64_t sum = 0;
+		table.for_each(0, 1000000000, [&sum](uint64_t p) { sum += p; });
+		return sum;
+	};
+	cout << "Summing all primes with for_each : " << timeit(1, walk) << endl;
+}
+
+/** pi(x) by the Lagarias-Miller-Odlyzko method, against sieving */
+void time13()
+{
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "Timings for prime_pi<uint64_t>:" << endl;
+	uint64_t x = 1000000000;
+	for (int e = 9; e <= 15; ++e) {
+		uint64_t pi;
+		auto func = [x,&pi]() { pi = dotime12(x,1); };
+		double t = timeit(1, func);
+		cout << "10^" << e << " : " << t << " (pi = " << pi << ")" << endl;
+		x *= 10;
+	}
+	cout << endl;
+	cout << "prime_pi<uint64_t>(10^14) with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime12(100000000000000ull,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+	cout << "Compare to count_primes<unsigned int>(0, 10^9) : ";
+	auto func = []() { dotime11(1000000000,1); };
+	cout << timeit(1, func) << endl;
+	cout << endl;
+}
+
+/** Sieve of Atkin against sieve_stripe<T>, over the same ranges and the same stripes */
+void time14()
+{
+	cout << "Timings for atkin_sieve<unsigned int> / sieve_stripe<unsigned int>, default stripe:" << endl;
+	unsigned int stripe = default_stripe_size();
+	unsigned int size = 10000, loops = 10000;
+	while ( size <= 1000000000 ) {
+		auto func = [size,stripe]() { dotime14(size,stripe); };
+		auto func1 = [size,stripe]() { dotime14a(size,stripe); };
+		cout << size << " ("<<loops<<") : " << timeit(loops, func) << " / " << timeit(loops, func1) << endl;
+		size *= 10;
+		loops /= 10;
+		if ( loops == 0 ) { loops=1; }
+	}
+	cout << endl;
+	cout << "Size 1,000,000,000, various stripe sizes (Atkin / Eratosthenes):" << endl;
+	std::vector<int> stripes{32,64,128,256,512,1024,2048,4096,8192};
+	for (auto ss : stripes) {
+		auto func = [ss]() { dotime14(1000000000,ss*1024); };
+		auto func1 = [ss]() { dotime14a(1000000000,ss*1024); };
+		cout << ss*1024/16 << " : " << timeit(1, func) << " / " << timeit(1, func1) << endl;
+	}
+	cout << endl;
+}
+
+/** Factoring windows of numbers with class multiplicative_sieve */
+void time15()
+{
+	cout << "Timings for multiplicative_window<uint64_t>, windows of 10,000,000:" << endl;
+	uint64_t start = 1000000;
+	for (int e = 6; e <= 15; e += 3) {
+		auto func = [start]() { dotime15(start,10000000); };
+		cout << "10^" << e << " : " << timeit(1, func) << endl;
+		start *= 1000;
+	}
+	cout << endl;
+}
+
+/** A slowly growing bound: class growable_sieve against rebuilding a wheel_sieve each time */
+void time16()
+{
+	cout << "Bound growing to 100,000,000 in equal steps (growable_sieve / rebuilding wheel_sieve):" << endl;
+	for (unsigned int steps : {1, 10, 100}) {
+		auto func = [steps]() { dotime16(100000000,steps); };
+		auto func1 = [steps]() { dotime16a(100000000,steps); };
+		cout << steps << " : " << timeit(1, func) << " / " << timeit(1, func1) << endl;
+	}
+	cout << endl;
+}
+
+/** Scattered is_prime() queries with class lazy_sieve, which only sieves where it's asked */
+void time17()
+{
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "lazy_sieve<uint64_t> up to 10^10, first query : ";
+	auto func = []() { dotime17(10000000000ull,1,1); };
+	cout << timeit(1, func) << endl;
+	cout << "Compare to count_primes<uint64_t>(0, 10^10) : ";
+	auto func1 = []() { count_primes<uint64_t>(0,10000000000ull); };
+	cout << timeit(1, func1) << endl;
+	cout << "1,000 random queries up to 10^10 : ";
+	auto func2 = []() { dotime17(10000000000ull,1000,1); };
+	cout << timeit(1, func2) << endl;
+	cout << "100,000 random queries up to 10^9 with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime17(1000000000ull,100000,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+}
+
+/** Memory and decoding speed of class compressed_prime_list, against a std::vector */
+void time18()
+{
+	auto plist = prime_list(1000000000u);
+	auto cl = compressed_prime_list_sieve(1000000000u);
+	cout << "Primes below 10^9 : " << plist.size() << endl;
+	cout << "std::vector<unsigned int> : " << plist.size() * sizeof(unsigned int) << " bytes" << endl;
+	cout << "compressed_prime_list : " << cl.memory_bytes() << " bytes" << endl;
+	cout << "Building it with compressed_prime_list_sieve : ";
+	auto func = []() { compressed_prime_list_sieve(1000000000u); };
+	cout << timeit(1, func) << endl;
+	cout << "Decoding it all : ";
+	auto func1 = [&cl]() { dotime18(cl); };
+	cout << timeit(3, func1) << endl;
+	cout << "Summing the std::vector : ";
+	auto func2 = [&plist]() { dotime18b(plist); };
+	cout << timeit(3, func2) << endl;
+	cout << "10^6 random lookups : ";
+	auto func3 = [&cl]() { dotime18a(cl, 1000000); };
+	cout << timeit(3, func3) << endl;
+	cout << endl;
+}
+
+/** parallel_prime_list with increasing numbers of threads, against prime_list2 */
+void time19()
+{
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "prime_list2<unsigned int> up to 10^9 : ";
+	auto func = []() { dotime4(1000000000,default_stripe_size()); };
+	cout << timeit(1, func) << endl;
+	cout << "parallel_prime_list<unsigned int> up to 10^9 with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime19(1000000000,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+}
+
+/** Sums of primes with prime_sum, against summing the list from prime_list2 */
+void time20()
+{
+	uint64_t size = 10000000;
+	while ( size <= 1000000000000ull ) {
+		auto func = [size]() { dotime20(size,1); };
+		cout << size << " : " << uint128_to_string(dotime20(size,1)) << " : " << timeit(1, func);
+		if ( size <= 1000000000 ) {
+			auto func1 = [size]() { dotime20a(size); };
+			cout << " / " << timeit(1, func1);
+		}
+		cout << endl;
+		size *= 10;
+	}
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "Up to 10^12 with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime20(1000000000000ull,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+}
+
+/** Gap statistics and tuple counts straight from the sieve, against making the list */
+void time21()
+{
+	auto stats = gap_statistics<uint64_t>(0, 1000000000);
+	cout << "Up to 10^9: " << stats.count << " primes, largest gap " << stats.max_gap() << " after "
+		<< stats.record_gaps.back().first << ", " << stats.tuple_counts[0] << " twin primes" << endl;
+	cout << "gap_statistics up to 10^9 : ";
+	auto func = []() { dotime21(1000000000,1); };
+	cout << timeit(1, func) << endl;
+	cout << "prime_list2 up to 10^9 : ";
+	auto func1 = []() { dotime4(1000000000,default_stripe_size()); };
+	cout << timeit(1, func1) << endl;
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "Up to 10^10 with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime21(10000000000ull,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+}
+
+/** Primes in a residue class with progression_sieve, against filtering the full list */
+void time22()
+{
+	for (uint64_t q : {4, 30, 1000, 1024}) {
+		cout << "Primes = 1 mod " << q << " up to 10^9 : ";
+		auto func = [q]() { dotime22(q,1,1000000000); };
+		cout << timeit(1, func) << " / ";
+		auto func1 = [q]() { dotime22a(q,1,1000000000); };
+		cout << timeit(1, func1) << endl;
+	}
+	cout << "Primes = 1 mod 1000 up to 10^11 : ";
+	auto func = []() { dotime22(1000,1,100000000000ull); };
+	cout << timeit(1, func) << endl;
+	cout << endl;
+}
+
+/** The k-th prime with nth_prime, against indexing the list from prime_list2 */
+void time23()
+{
+	uint64_t k = 1000000;
+	while ( k <= 10000000000ull ) {
+		auto func = [k]() { dotime23(k,1); };
+		cout << k << " : " << dotime23(k,1) << " : " << timeit(1, func);
+		if ( k <= 10000000 ) {
+			// A bound chosen with hindsight, as it would have to be by hand
+			uint64_t bound = dotime23(k,1);
+			auto func1 = [k,bound]() { dotime23a(k,bound); };
+			cout << " / " << timeit(1, func1);
+		}
+		cout << endl;
+		k *= 10;
+	}
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	cout << "k = 10^10 with increasing numbers of threads:" << endl;
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		auto func = [threads]() { dotime23(10000000000ull,threads); };
+		cout << threads << " : " << timeit(1, func) << endl;
+	}
+	cout << endl;
+}
+
+/** Cycles, instructions per cycle and cache misses for each stripe size and number of
+  * threads, from the hardware counters */
+void time24()
+{
+	if ( ! perf_counters_available() ) {
+		cout << "Hardware counters unavailable (not Linux, or perf_event_paranoid too high)" << endl;
+	}
+	unsigned int l1 = default_stripe_size();
+	for (unsigned int ssize : { l1/4, l1, 4*l1, 32*l1 }) {
+		cout << "prime_list3 to 10^9, stripe " << ssize << ":" << endl;
+		print_perf_report(cout, dotime24a(1000000000, ssize));
+	}
+	unsigned int maxthreads = std::thread::hardware_concurrency();
+	if ( maxthreads == 0 ) { maxthreads = 1; }
+	for (unsigned int threads = 1; threads <= maxthreads; threads *= 2) {
+		for (unsigned int ssize : { l1, 8*l1 }) {
+			cout << "sieve_stripe to 10^9, " << threads << " threads, stripe " << ssize << ":" << endl;
+			print_perf_report(cout, dotime24(1000000000, ssize, threads));
+		}
+	}
+	cout << endl;
+}
+
+/** Batches of short queries with prime_batch_sieve, against one primes_range call each */
+void time25()
+{
+	const uint64_t top = 10000000000ull;
+	prime_batch_sieve<uint64_t> bs(top);
+	prime_sieve_list<uint64_t> pl(integer_sqrt(top) + 1);
+	for (uint64_t spread : {top, top / 1000, top / 100000}) {
+		for (uint64_t width : {100ull, 10000ull}) {
+			// 10000 queries scattered through [top - spread, top]
+			std::vector<std::pair<uint64_t, uint64_t>> queries;
+			uint64_t state = 1;
+			for (int i = 0; i < 10000; ++i) {
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+				uint64_t start = top - spread + (state >> 20) % (spread - width);
+				queries.push_back(std::make_pair(start, start + width));
+			}
+			cout << "Spread " << spread << ", width " << width << " : ";
+			auto func = [&bs,&queries]() { dotime25(bs, queries); };
+			cout << timeit(1, func) << " / ";
+			auto func1 = [&pl,&queries]() { dotime25a(pl, queries); };
+			cout << timeit(1, func1) << endl;
+		}
+	}
+	cout << endl;
+}
+
+/** Lists of primes through the 64-bit front end prime_list_dispatch, against the
+  * uint64_t instantiation (and the unsigned int one, where it can be used) */
+void time26()
+{
+	const uint64_t two32 = 4294967296ull;
+	const uint64_t ranges[][2] = { {0, 1000000000}, {two32 - 1000000000, two32 - 1},
+		{two32 - 500000000, two32 + 500000000}, {100000000000ull, 101000000000ull} };
+	for (const auto &r : ranges) {
+		uint64_t start = r[0], end = r[1];
+		std::size_t count = dotime26(start, end);
+		cout << "[" << start << ", " << end << "], " << count << " primes : ";
+		auto func = [start,end]() { dotime26(start, end); };
+		cout << timeit(1, func) << " (" << count * sizeof(uint32_t) / 1000000 << "MB) / ";
+		auto func1 = [start,end]() { dotime26a(start, end); };
+		cout << timeit(1, func1) << " (" << count * sizeof(uint64_t) / 1000000 << "MB)";
+		if ( end < two32 ) {
+			auto func2 = [start,end]() { dotime26b(start, end); };
+			cout << " / " << timeit(1, func2);
+		}
+		cout << endl;
+	}
+	cout << endl;
+}
+
+/** Show the detected cache sizes, and calibrate the stripe size (saved to stripe_size.cfg) */
+void time_cache()
+{
+	const cache_geometry &cg = cache_info();
+	cout << "L1 data cache: " << cg.l1d << " bytes, L2 cache: " << cg.l2
+		<< " bytes, cache line: " << cg.line << " bytes" << endl;
+	cout << "Default stripe size: " << default_stripe_size() << endl;
+	cout << "Calibrated stripe size: " << calibrate_stripe_size("stripe_size.cfg") << endl;
 }
 
 int main()
 {
 	//if ( ! tests() ) { return 1; }
+	//time_cache();
 	
 	/*time1();
 	time2();
@@ -286,8 +814,28 @@ int main()
 	time5b();
 	time6();
 	time7();
+	time7a();
 	time8();
-	time8a();*/
+	time8a();
+	time8b();
+	time9();
+	time10();
+	time11();
+	time12();
+	time13();
+	time14();
+	time15();
+	time16();
+	time17();
+	time18();
+	time19();
+	time20();
+	time21();
+	time22();
+	time23();
+	time24();
+	time25();
+	time26();*/
 
 	cout << "1-thread, billion." << endl;
 	for (int n=0; n<20; ++n) {
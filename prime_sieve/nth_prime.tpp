@@ -0,0 +1,130 @@
+/** @file: nth_prime.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  The k-th prime, without listing the first k primes: estimate it with the inverse of
+ *  the logarithmic integral, count the primes up to the estimate exactly with prime_pi,
+ *  and sieve just the gap between the two.
+ */
+
+#ifndef __NTH_PRIME_TPP
+#define __NTH_PRIME_TPP
+
+
+#include "sieve.tpp"
+#include "prime_count.tpp"
+#include "small_primes.tpp"
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+
+/** The logarithmic integral li(x), the integral from 0 to x of 1/log t, for x > 1, by
+  * Ramanujan's series, which converges quickly:
+  *   li(x) = gamma + log log x + sqrt(x) sum_{n>=1} (-1)^(n-1) (log x)^n / (n! 2^(n-1))
+  *                                                   * sum_{j=0}^{(n-1)/2} 1/(2j+1)
+  */
+inline long double logarithmic_integral(long double x)
+{
+	const long double gamma = 0.5772156649015328606065120900824024L;
+	long double lx = std::log(x);
+	long double sum = 0, term = 1, inner = 0;
+	for (int n = 1; n < 200; ++n) {
+		term *= -lx / (n * 2.0L);       // (-1)^n (log x)^n / (n! 2^n)
+		if ( (n-1) % 2 == 0 ) { inner += 1.0L / n; }
+		long double add = -2 * term * inner;
+		sum += add;
+		if ( std::fabs(add) < 1e-20L * std::fabs(sum) ) { break; }
+	}
+	return gamma + std::log(lx) + std::sqrt(x) * sum;
+}
+
+/** x with li(x) = k, by Newton's method from x = k log k */
+inline long double inverse_logarithmic_integral(long double k)
+{
+	if ( k < 2 ) { return 2; }
+	long double x = k * std::log(k);
+	for (int i = 0; i < 100; ++i) {
+		long double step = (logarithmic_integral(x) - k) * std::log(x);
+		x -= step;
+		if ( x < 2 ) { x = 2; }
+		if ( std::fabs(step) < 0.5L ) { break; }
+	}
+	return x;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// nth_prime code
+// --------------------------------------------------------------------------
+
+/** The k-th prime (so nth_prime(1) = 2), or 0 if k = 0 or the answer doesn't fit in T.
+  *
+  * x = li^{-1}(k) is within about sqrt(x) log x of the answer.  prime_pi(x) (see
+  * prime_count.tpp, using `threads` threads) gives the exact count up to there, in about
+  * O(x^(2/3)) time and O(x^(1/3)) memory; then windows of the odd numbers next to x are
+  * sieved with prime_sieve_list<T>::partial_sieve, forwards or backwards, until the k-th
+  * prime turns up, usually in the first window.  The sieving primes run up to the square
+  * root of Rosser's bound k(log k + log log k), so memory is O(sqrt(p_k)).
+  */
+template <typename T>
+T nth_prime(const uint64_t k, unsigned int threads = 1)
+{
+	if ( k == 0 ) { return 0; }
+	if ( k <= small_prime_count ) {
+		uint64_t p = small_primes[k-1];
+		return ( p > std::numeric_limits<T>::max() ) ? 0 : static_cast<T>(p);
+	}
+	const long double top = std::numeric_limits<T>::max();
+	if ( top < small_prime_limit ) { return 0; } // The next prime is 65537
+	long double lk = std::log(static_cast<long double>(k));
+	long double upper = k * (lk + std::log(lk));            // p_k < upper, for k >= 6
+	long double lower = k * (lk + std::log(lk) - 1);        // p_k > lower, for k >= 2
+	if ( lower >= top ) { return 0; }
+	long double estimate = inverse_logarithmic_integral(static_cast<long double>(k));
+	estimate = std::min(std::max(estimate, lower), std::min(upper, top));
+	T x = static_cast<T>(estimate);
+
+	T sqrt_bound = integer_sqrt(static_cast<T>(std::min(upper, top)));
+	prime_sieve_list<T> pl(sqrt_bound + 1);
+	uint64_t count = prime_pi<uint64_t>(x, threads);   // Number of primes <= x
+	T window = static_cast<T>(std::max<uint64_t>(65536, 2*uint64_t(sqrt_bound)));
+	window -= window % 2;
+	if ( count < k ) {
+		// Forwards, over the odd numbers from x+1; none of them fit in T if x is the largest
+		if ( x == std::numeric_limits<T>::max() ) { return 0; }
+		T start = x + 1;
+		while ( true ) {
+			T end = ( top - start < window ) ? std::numeric_limits<T>::max() : start + (window - 1);
+			std::vector<T> primes = pl.sieve_to_list(start, pl.partial_sieve(start, end));
+			if ( count + primes.size() >= k ) { return primes[k - count - 1]; }
+			count += primes.size();
+			if ( end == std::numeric_limits<T>::max() ) { return 0; }
+			start = end + 1;
+		}
+	}
+	// Backwards, over the odd numbers up to x: the last prime found is the count-th
+	T end = x;
+	while ( true ) {
+		T start = ( end < window ) ? 0 : end - (window - 1);
+		if ( start <= sqrt_bound ) { start = sqrt_bound + 1; } // Not reached: k is large
+		std::vector<T> primes = pl.sieve_to_list(start, pl.partial_sieve(start, end));
+		if ( count - primes.size() < k ) { return primes[k - (count - primes.size()) - 1]; }
+		count -= primes.size();
+		end = start - 1;
+	}
+}
+
+
+
+/** Various testing routines */
+/** Tests nth_prime against prime_list */
+bool test27();
+
+
+#endif // __NTH_PRIME_TPP
@@ -0,0 +1,149 @@
+/** @file: packed_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Segments of the odds-only sieve packed into 64-bit words, so that they can be
+ *  processed a word at a time, and counting primes with these.
+ */
+
+#ifndef __PACKED_SIEVE_TPP
+#define __PACKED_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <initializer_list>
+
+
+// --------------------------------------------------------------------------
+// Packed segments
+// --------------------------------------------------------------------------
+
+/** The first step of packed_sieve_segment() below: set `words` to the odd numbers from `start`
+  * with no factor up to 17 (but with those primes themselves set).  Returns the last
+  * number, start + 2*(bits-1). */
+template <typename T>
+T packed_presieve_segment(T start, T bits, uint64_t *words)
+{
+	T nwords = (bits+63)/64;
+	get_odd_presieve().fill(words, nwords, start/2);
+	if ( bits%64 != 0 ) { words[nwords-1] &= ~uint64_t(0) >> (64 - bits%64); }
+	T end = start + 2*(bits-1);
+	if ( start <= odd_presieve::largest_prime ) {
+		// Put back the primes the pattern crossed off; and 1 is not prime
+		for (T p : {3, 5, 7, 11, 13, 17}) {
+			if ( p >= start and p <= end ) { words[(p-start)/2/64] |= uint64_t(1) << ((p-start)/2%64); }
+		}
+		if ( start == 1 ) { words[0] &= ~uint64_t(1); }
+	}
+	return end;
+}
+
+/** Sieve the odd numbers start, start+2, ..., start+2*(bits-1) into `words`, which must
+  * have room for (bits+63)/64 words: bit i of words[i/64] is start+2i, and is set if
+  * that number is prime.  Unused bits of the last word are cleared.
+  * `start` must be odd, and `primes` must contain (at least) all the primes up to the
+  * square root of the last number, starting with 2 (which is skipped).  Each prime is
+  * crossed off from its square, so the range may include the sieving primes themselves.
+  * The primes up to 17 come from the pre-sieve pattern, and are not crossed off here.
+  */
+template <typename T>
+void packed_sieve_segment(const std::vector<T> &primes, T start, T bits, uint64_t *words)
+{
+	T end = packed_presieve_segment(start, bits, words);
+	T root = integer_sqrt(end);   // Once, rather than a division for every prime
+	for (auto it = primes.begin()+1; it != primes.end(); ++it) {
+		T p = *it;
+		if ( p <= odd_presieve::largest_prime ) { continue; }
+		if ( p > root ) { break; }
+		T ps = p*p;
+		if ( ps < start ) {
+			T r = start % p;
+			ps = start + (r == 0 ? 0 : p - r);
+			if ( (ps%2)==0 ) { ps += p; } // ps smallest odd multiple of p greater than or equal to start
+		}
+		for (T j = (ps-start)/2; j < bits; j += p) {
+			words[j/64] &= ~(uint64_t(1) << (j%64));
+		}
+	}
+}
+
+/** Number of set bits, i.e. primes, in a packed segment */
+inline uint64_t packed_count(const uint64_t *words, std::size_t nwords)
+{
+	uint64_t count = 0;
+	for (std::size_t w = 0; w < nwords; ++w) {
+		count += __builtin_popcountll(words[w]);
+	}
+	return count;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+
+/** Number of primes in [lo, hi], without making a list.
+  * The odd numbers are sieved a segment of `segment_size` integers at a time (by default
+  * filling the L1 cache) into packed words, which are counted with popcount.  With more
+  * than one thread, each thread counts a contiguous run of segments and the counts are
+  * added up at the end.
+  */
+template <typename T>
+uint64_t count_primes(T lo, T hi, unsigned int threads = 1, T segment_size = 0)
+{
+	if ( hi < lo ) { return 0; }
+	uint64_t count = ( lo <= 2 and hi >= 2 ) ? 1 : 0;
+	if ( lo < 3 ) { lo = 3; }
+	lo += 1 - (lo%2); // Increase, if necessary, to make odd
+	if ( lo > hi ) { return count; }
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	if ( segment_size == 0 ) { segment_size = default_stripe_size(); }
+	T bits = segment_size / 2;
+	bits += (64 - bits%64) % 64;
+	if ( bits == 0 ) { bits = 64; }
+
+	prime_sieve_list<T> pl(integer_sqrt(hi) + 1);
+	T total_bits = (hi - lo) / 2 + 1;
+	T numsegs = (total_bits - 1) / bits + 1;
+	if ( numsegs < threads ) { threads = numsegs; }
+	std::vector<uint64_t> counts(threads, 0);
+	auto work = [&pl,&counts,lo,bits,total_bits,numsegs,threads](unsigned int me) {
+		std::vector<uint64_t> words(bits/64);
+		T first = numsegs / threads * me + std::min<T>(me, numsegs % threads);
+		T last = first + numsegs / threads + ( me < numsegs % threads ? 1 : 0 );
+		uint64_t c = 0;
+		for (T k = first; k < last; ++k) {
+			T b = total_bits - k*bits;
+			if ( b > bits ) { b = bits; }
+			packed_sieve_segment(pl.primes, lo + 2*k*bits, b, words.data());
+			c += packed_count(words.data(), (b+63)/64);
+		}
+		counts[me] = c;
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) {
+		workers.push_back(std::thread(work, i));
+	}
+	work(0);
+	for (auto &w : workers) { w.join(); }
+	for (auto c : counts) { count += c; }
+	return count;
+}
+
+
+
+/** Various testing routines */
+/** Tests that count_primes agrees with prime_list */
+bool test12();
+
+
+#endif // __PACKED_SIEVE_TPP
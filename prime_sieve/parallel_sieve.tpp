@@ -0,0 +1,305 @@
+/** @file: parallel_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Computing a sieve_stripe<T> or wheel_sieve<T> with any number of threads.
+ */
+
+#ifndef __PARALLEL_SIEVE_TPP
+#define __PARALLEL_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "wheel_sieve.tpp"
+#include "packed_sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+
+// --------------------------------------------------------------------------
+// Segment alignment for each sieve class
+// --------------------------------------------------------------------------
+
+/** The sieve classes sieve_stripe<T>, wheel_sieve<T> and atkin_sieve<T> (in atkin_sieve.tpp)
+  * share an interface, so the code here, and the timings, work with any of them:
+  *   - `Sieve(T len)` finds the small primes and allocates the sieve for [0, len];
+  *   - `void compute_section(T start, T end)` computes a part of the sieve, and may be
+  *     called on sections in any order;
+  *   - `bool is_prime(T p)const` and `std::vector<T> prime_list()const` read the result;
+  *   - a specialisation of sieve_alignment<Sieve>, below.
+  */
+
+/** Segments are [offset + k*granule, offset + (k+1)*granule - 1] (or a multiple of
+  * granule) so that each segment starts at the beginning of a 64 byte cache line
+  * of the underlying storage.
+  */
+template <typename Sieve>
+struct sieve_alignment;
+
+/** std::vector<bool> with index n -> 3+2n: 512 bits cover 1024 integers. */
+template <typename T>
+struct sieve_alignment<sieve_stripe<T>> {
+	static T offset() { return 3; }
+	static T granule() { return 1024; }
+};
+
+/** One byte per 30 integers: 64 bytes cover 1920 integers. */
+template <typename T>
+struct sieve_alignment<wheel_sieve<T>> {
+	static T offset() { return 0; }
+	static T granule() { return 1920; }
+};
+
+
+// --------------------------------------------------------------------------
+// class work_deque<Item> code
+// --------------------------------------------------------------------------
+
+/** Double ended queue for work stealing.  The owning thread takes work from the front,
+  * and other threads steal from the back.  Segments are only ever handed out, never
+  * added while the threads run, so a simple lock is perfectly adequate: each deque is
+  * touched by its owner once per segment and by a thief only when it has run dry.
+  */
+template <typename Item>
+class work_deque {
+public:
+	void push_back(const Item &item);
+	bool pop_front(Item &item);
+	bool steal_back(Item &item);
+private:
+	std::mutex lock;
+	std::deque<Item> items;
+};
+
+template <typename Item>
+void work_deque<Item>::push_back(const Item &item)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	items.push_back(item);
+}
+
+template <typename Item>
+bool work_deque<Item>::pop_front(Item &item)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if ( items.empty() ) { return false; }
+	item = items.front();
+	items.pop_front();
+	return true;
+}
+
+template <typename Item>
+bool work_deque<Item>::steal_back(Item &item)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if ( items.empty() ) { return false; }
+	item = items.back();
+	items.pop_back();
+	return true;
+}
+
+
+// --------------------------------------------------------------------------
+// parallel_compute code
+// --------------------------------------------------------------------------
+
+/** What each thread did: the number of segments computed, and how many of those
+  * were stolen from another thread's deque.
+  */
+struct parallel_sieve_report {
+	std::vector<unsigned int> segments;
+	std::vector<unsigned int> stolen;
+};
+
+/** Compute all of `s`, which should have been constructed with length `len`, using
+  * `threads` threads (0 means std::thread::hardware_concurrency()).
+  * The range is split into segments of (about) `segment_size` integers (by default,
+  * enough to fill the L1 data cache; see default_stripe_size()), rounded to
+  * a multiple of sieve_alignment<Sieve>::granule() so that no two segments share a word
+  * of the sieve (and so no data race, even for std::vector<bool>) and segment boundaries
+  * fall on cache line boundaries.  Thread i starts with the i-th contiguous run of
+  * segments in its deque, working upwards, and when that runs dry steals from the top
+  * end of the other threads' deques.
+  */
+template <typename Sieve, typename T>
+parallel_sieve_report parallel_compute(Sieve &s, T len, unsigned int threads, T segment_size = 0)
+{
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	T offset = sieve_alignment<Sieve>::offset();
+	T granule = sieve_alignment<Sieve>::granule();
+	if ( segment_size == 0 ) { segment_size = default_stripe_size(granule / 64); }
+	if ( segment_size < granule ) { segment_size = granule; }
+	segment_size -= segment_size % granule;
+
+	// Segment k is [offset + k*segment_size, offset + (k+1)*segment_size - 1]
+	T numsegs = 1;
+	if ( len > offset ) { numsegs = (len - offset) / segment_size + 1; }
+	std::vector<work_deque<T>> deques(threads);
+	for (unsigned int i=0; i<threads; ++i) {
+		T first = numsegs / threads * i + std::min<T>(i, numsegs % threads);
+		T last = first + numsegs / threads + ( i < numsegs % threads ? 1 : 0 );
+		for (T k = first; k < last; ++k) { deques[i].push_back(k); }
+	}
+
+	parallel_sieve_report report;
+	report.segments.resize(threads, 0);
+	report.stolen.resize(threads, 0);
+	auto compute = [&s,&deques,&report,offset,segment_size,threads](unsigned int me) {
+		T k;
+		unsigned int done = 0, stolen = 0;
+		while ( true ) {
+			if ( ! deques[me].pop_front(k) ) {
+				bool found = false;
+				for (unsigned int i=1; i<threads and !found; ++i) {
+					found = deques[(me+i)%threads].steal_back(k);
+				}
+				if ( !found ) { break; }
+				++stolen;
+			}
+			T start = offset + k*segment_size;
+			T end = start + (segment_size - 1);
+			if ( end < start ) { end = std::numeric_limits<T>::max(); }
+			s.compute_section(start, end);
+			++done;
+		}
+		// Each thread writes only its own entries
+		report.segments[me] = done;
+		report.stolen[me] = stolen;
+	};
+
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) {
+		workers.push_back(std::thread(compute, i));
+	}
+	compute(0);
+	for (auto &w : workers) { w.join(); }
+	return report;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+
+/** All the primes up to `len`, using any of the sieve classes, computed one stripe at a
+  * time on a single thread.  Stripes are aligned as in parallel_compute().
+  */
+template <typename Sieve, typename T>
+std::vector<T> engine_prime_list(T len, T stripe_size)
+{
+	Sieve s(len);
+	T offset = sieve_alignment<Sieve>::offset();
+	T granule = sieve_alignment<Sieve>::granule();
+	if ( stripe_size < granule ) { stripe_size = granule; }
+	stripe_size -= stripe_size % granule;
+	for (T start = offset; start <= len; start += stripe_size) {
+		T end = start + (stripe_size - 1);
+		if ( end < start ) { end = std::numeric_limits<T>::max(); }
+		s.compute_section(start, end);
+		if ( end >= len ) { break; }
+	}
+	return s.prime_list();
+}
+
+
+// --------------------------------------------------------------------------
+// parallel_prime_list code
+// --------------------------------------------------------------------------
+
+/** All the primes up to `len`, using `threads` threads (0 means
+  * std::thread::hardware_concurrency()).
+  * The odd numbers are split into segments of about `segment_size` integers (by default
+  * filling the L1 data cache), handed out and stolen exactly as in parallel_compute().
+  * Each segment is sieved with packed_sieve_segment() into a buffer belonging to the
+  * thread, and its primes are extracted into a vector belonging to the segment.  Then a
+  * prefix sum over the counts gives each segment its place in the output, and the threads
+  * copy their share of the segments into place.  No locks are taken on the output: every
+  * vector, and every part of the result, is written by exactly one thread.
+  */
+template <typename T>
+std::vector<T> parallel_prime_list(const T len, unsigned int threads = 0, T segment_size = 0)
+{
+	std::vector<T> result;
+	if ( len < 2 ) { return result; }
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	uint64_t bits = ( segment_size == 0 ) ? default_stripe_size() / 2 : segment_size / 2;
+	bits -= bits % 64;
+	if ( bits == 0 ) { bits = 64; }
+
+	// Segment k is the odd numbers from 3 + 2*k*bits, up to len
+	uint64_t total_bits = (static_cast<uint64_t>(len) - 1) / 2;
+	std::size_t numsegs = static_cast<std::size_t>((total_bits + bits - 1) / bits);
+	if ( threads > numsegs ) { threads = numsegs == 0 ? 1 : static_cast<unsigned int>(numsegs); }
+	std::vector<work_deque<std::size_t>> deques(threads);
+	for (unsigned int i=0; i<threads; ++i) {
+		std::size_t first = numsegs / threads * i + std::min<std::size_t>(i, numsegs % threads);
+		std::size_t last = first + numsegs / threads + ( i < numsegs % threads ? 1 : 0 );
+		for (std::size_t k = first; k < last; ++k) { deques[i].push_back(k); }
+	}
+	std::vector<T> primes = small_prime_list<T>(integer_sqrt(len) + 1);
+	std::vector<std::vector<T>> found(numsegs);
+
+	auto sieve = [&primes,&deques,&found,bits,total_bits,threads](unsigned int me) {
+		std::vector<uint64_t> words(bits / 64);
+		std::size_t k;
+		while ( true ) {
+			if ( ! deques[me].pop_front(k) ) {
+				bool stolen = false;
+				for (unsigned int i=1; i<threads and !stolen; ++i) {
+					stolen = deques[(me+i)%threads].steal_back(k);
+				}
+				if ( !stolen ) { break; }
+			}
+			uint64_t first_bit = k * bits;
+			T b = static_cast<T>(std::min(bits, total_bits - first_bit));
+			T start = static_cast<T>(3 + 2*first_bit);
+			packed_sieve_segment(primes, start, b, words.data());
+			found[k].reserve(prime_count_upper_bound(start, static_cast<T>(start + 2*(b-1))));
+			extract_bits_pushback(words.data(), static_cast<std::size_t>(b), start, T(2), found[k]);
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) { workers.push_back(std::thread(sieve, i)); }
+	sieve(0);
+	for (auto &w : workers) { w.join(); }
+
+	// offsets[k] is where segment k goes; 2 comes first
+	std::vector<std::size_t> offsets(numsegs + 1);
+	offsets[0] = 1;
+	for (std::size_t k = 0; k < numsegs; ++k) { offsets[k+1] = offsets[k] + found[k].size(); }
+	result.resize(offsets[numsegs]);
+	result[0] = 2;
+	auto copy = [&result,&found,&offsets,numsegs,threads](unsigned int me) {
+		for (std::size_t k = numsegs * me / threads; k < numsegs * (me+1) / threads; ++k) {
+			std::copy(found[k].begin(), found[k].end(), result.begin() + offsets[k]);
+			std::vector<T>().swap(found[k]);
+		}
+	};
+	workers.clear();
+	for (unsigned int i=1; i<threads; ++i) { workers.push_back(std::thread(copy, i)); }
+	copy(0);
+	for (auto &w : workers) { w.join(); }
+	return result;
+}
+
+
+
+/** Various testing routines */
+/** Tests that parallel_compute with sieve_stripe and wheel_sieve agrees with prime_list */
+bool test8();
+/** Tests parallel_prime_list against prime_list */
+bool test23();
+
+
+#endif // __PARALLEL_SIEVE_TPP
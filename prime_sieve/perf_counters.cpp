@@ -0,0 +1,275 @@
+/** @file: perf_counters.cpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Reading the hardware performance counters around each stripe of the sieve, with
+ *  Linux's perf_event_open.
+ */
+
+#include "perf_counters.h"
+
+#include <mutex>
+#include <iomanip>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+
+std::atomic<bool> perf_instrumentation_on(false);
+
+namespace {
+
+const unsigned int perf_counter_count = 4;
+
+/** Everything recorded, guarded by `lock`.  Adding a stripe takes the lock, which is
+  * cheap next to reading the counters.  `session` counts calls to perf_instrumentation(true),
+  * so that threads number themselves afresh in each. */
+std::mutex lock;
+std::vector<perf_stripe> recorded;
+unsigned int valid = (1u << perf_counter_count) - 1;
+unsigned int session = 0;
+unsigned int threads_seen = 0;
+
+/** The counters of one thread, opened on first use, as one group led by the cycle counter
+  * so that they are read together.  `slot[i]` is the place in the group of counter i, or
+  * -1 if it couldn't be opened. */
+struct thread_counters {
+	int leader;
+	std::vector<int> fds;
+	int slot[perf_counter_count];
+	bool tried;
+	unsigned int session, thread;
+	thread_counters() : leader{-1}, tried{false}, session{0}, thread{0}
+		{ for (auto &s : slot) { s = -1; } }
+	~thread_counters();
+	void open();
+	bool read(perf_sample &sample);
+};
+
+thread_local thread_counters counters;
+
+#if defined(__linux__)
+
+int open_counter(uint32_t type, uint64_t config, int group)
+{
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.disabled = ( group == -1 ) ? 1 : 0;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP;
+	return static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, group, 0));
+}
+
+thread_counters::~thread_counters()
+{
+	for (auto fd : fds) { close(fd); }
+}
+
+void thread_counters::open()
+{
+	tried = true;
+	leader = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1);
+	if ( leader == -1 ) { return; }
+	fds.push_back(leader);
+	slot[0] = 0;
+	const uint32_t types[] = { PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE, PERF_TYPE_HARDWARE };
+	const uint64_t configs[] = { PERF_COUNT_HW_INSTRUCTIONS,
+		PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+		PERF_COUNT_HW_CACHE_MISSES };
+	for (unsigned int i = 1; i < perf_counter_count; ++i) {
+		int fd = open_counter(types[i-1], configs[i-1], leader);
+		if ( fd != -1 ) {
+			slot[i] = static_cast<int>(fds.size());
+			fds.push_back(fd);
+		}
+	}
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+bool thread_counters::read(perf_sample &sample)
+{
+	if ( ! tried ) { open(); }
+	uint64_t values[perf_counter_count] = {0, 0, 0, 0};
+	if ( leader != -1 ) {
+		uint64_t buffer[1 + perf_counter_count];
+		if ( ::read(leader, buffer, sizeof(buffer)) > 0 ) {
+			for (unsigned int i = 0; i < perf_counter_count; ++i) {
+				if ( slot[i] != -1 and static_cast<uint64_t>(slot[i]) < buffer[0] ) { values[i] = buffer[1 + slot[i]]; }
+			}
+		}
+	}
+	sample.cycles = values[0];
+	sample.instructions = values[1];
+	sample.l1d_misses = values[2];
+	sample.llc_misses = values[3];
+	return leader != -1;
+}
+
+#else
+
+thread_counters::~thread_counters() { }
+
+void thread_counters::open() { tried = true; }
+
+bool thread_counters::read(perf_sample &sample)
+{
+	if ( ! tried ) { open(); }
+	sample = perf_sample{0, 0, 0, 0};
+	return false;
+}
+
+#endif
+
+/** Bits of perf_report::valid which this thread can read */
+unsigned int thread_valid()
+{
+	unsigned int v = 0;
+	for (unsigned int i = 0; i < perf_counter_count; ++i) {
+		if ( counters.slot[i] != -1 ) { v |= 1u << i; }
+	}
+	return v;
+}
+
+} // namespace
+
+
+bool perf_counters_available()
+{
+	perf_sample sample;
+	return counters.read(sample);
+}
+
+void perf_instrumentation(bool on)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if ( on ) {
+		recorded.clear();
+		valid = (1u << perf_counter_count) - 1;
+		++session;
+		threads_seen = 0;
+	}
+	perf_instrumentation_on.store(on, std::memory_order_relaxed);
+}
+
+perf_report perf_collect()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	perf_report report;
+	report.valid = valid;
+	report.stripes = recorded;
+	return report;
+}
+
+void perf_stripe_scope::begin()
+{
+	counters.read(start);
+}
+
+void perf_stripe_scope::end()
+{
+	perf_sample now;
+	counters.read(now);
+	perf_stripe stripe;
+	stripe.counts.cycles = now.cycles - start.cycles;
+	stripe.counts.instructions = now.instructions - start.instructions;
+	stripe.counts.l1d_misses = now.l1d_misses - start.l1d_misses;
+	stripe.counts.llc_misses = now.llc_misses - start.llc_misses;
+	stripe.site = site;
+	stripe.integers = integers;
+	std::lock_guard<std::mutex> guard(lock);
+	if ( counters.session != session ) {
+		counters.session = session;
+		counters.thread = threads_seen++;
+		valid &= thread_valid();
+	}
+	stripe.thread = counters.thread;
+	recorded.push_back(stripe);
+}
+
+
+// --------------------------------------------------------------------------
+// Reports
+// --------------------------------------------------------------------------
+
+namespace {
+
+void add(perf_sample &total, const perf_sample &s)
+{
+	total.cycles += s.cycles;
+	total.instructions += s.instructions;
+	total.l1d_misses += s.l1d_misses;
+	total.llc_misses += s.llc_misses;
+}
+
+void print_line(std::ostream &out, const perf_sample &s, uint64_t stripes, uint64_t integers, unsigned int valid)
+{
+	out << stripes << " stripes, " << integers << " integers";
+	if ( valid & 1 ) { out << ", " << s.cycles << " cycles"; }
+	if ( (valid & 3) == 3 and s.cycles > 0 ) {
+		out << ", IPC " << std::setprecision(3) << double(s.instructions) / s.cycles;
+	}
+	if ( integers > 0 ) {
+		if ( valid & 4 ) { out << ", L1D misses/1000 integers " << std::setprecision(4) << 1000.0 * s.l1d_misses / integers; }
+		if ( valid & 8 ) { out << ", LLC misses/1000 integers " << std::setprecision(4) << 1000.0 * s.llc_misses / integers; }
+	}
+	out << std::endl;
+}
+
+} // namespace
+
+std::vector<perf_sample> perf_report::thread_totals() const
+{
+	std::vector<perf_sample> totals;
+	for (const auto &s : stripes) {
+		if ( s.thread >= totals.size() ) { totals.resize(s.thread + 1, perf_sample{0, 0, 0, 0}); }
+		add(totals[s.thread], s.counts);
+	}
+	return totals;
+}
+
+perf_sample perf_report::site_total(perf_site site) const
+{
+	perf_sample total{0, 0, 0, 0};
+	for (const auto &s : stripes) {
+		if ( s.site == site ) { add(total, s.counts); }
+	}
+	return total;
+}
+
+void print_perf_report(std::ostream &out, const perf_report &report)
+{
+	if ( report.valid == 0 ) {
+		out << "(hardware counters unavailable; only stripe counts are shown)" << std::endl;
+	}
+	const char *names[] = { "compute_section", "partial_sieve" };
+	for (int site = 0; site < 2; ++site) {
+		uint64_t stripes = 0, integers = 0;
+		for (const auto &s : report.stripes) {
+			if ( s.site == site ) { ++stripes; integers += s.integers; }
+		}
+		if ( stripes == 0 ) { continue; }
+		out << names[site] << " : ";
+		print_line(out, report.site_total(static_cast<perf_site>(site)), stripes, integers, report.valid);
+	}
+	auto totals = report.thread_totals();
+	if ( totals.size() > 1 ) {
+		for (unsigned int t = 0; t < totals.size(); ++t) {
+			uint64_t stripes = 0, integers = 0;
+			for (const auto &s : report.stripes) {
+				if ( s.thread == t ) { ++stripes; integers += s.integers; }
+			}
+			out << "  thread " << t << " : ";
+			print_line(out, totals[t], stripes, integers, report.valid);
+		}
+	}
+}
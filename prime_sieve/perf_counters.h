@@ -0,0 +1,93 @@
+/** @file: perf_counters.h
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Reading the hardware performance counters (cycles, instructions, L1 data cache and
+ *  last level cache misses) around each stripe of the sieve, so that the choice of stripe
+ *  size and number of threads can be made from measurements.  Linux only, using
+ *  perf_event_open; elsewhere the counters are simply unavailable.
+ */
+
+#ifndef __PERF_COUNTERS_H
+#define __PERF_COUNTERS_H
+
+#include <vector>
+#include <ostream>
+#include <atomic>
+#include <cstdint>
+
+/** Counter values.  A counter which couldn't be opened reads as zero. */
+struct perf_sample {
+	uint64_t cycles;
+	uint64_t instructions;
+	uint64_t l1d_misses;
+	uint64_t llc_misses;
+};
+
+/** Which function a stripe was timed in */
+enum perf_site {
+	perf_compute_section = 0,   // sieve_stripe<T>::compute_section
+	perf_partial_sieve = 1      // prime_sieve_list<T>::partial_sieve
+};
+
+/** One stripe: the counters, the thread (numbered in order of first use) and the number
+  * of integers sieved */
+struct perf_stripe {
+	perf_sample counts;
+	unsigned int thread;
+	perf_site site;
+	uint64_t integers;
+};
+
+/** Everything recorded since perf_instrumentation(true).  Bit i of `valid` is set if
+  * counter i (in the order of perf_sample) could be read on every thread. */
+struct perf_report {
+	unsigned int valid;
+	std::vector<perf_stripe> stripes;
+	std::vector<perf_sample> thread_totals() const;
+	perf_sample site_total(perf_site site) const;
+};
+
+/** Can the counters be read on this thread? */
+bool perf_counters_available();
+
+/** Turn the instrumentation on (discarding anything recorded before) or off.  Call this,
+  * and perf_collect(), only while no sieve is running. */
+void perf_instrumentation(bool on);
+
+/** What has been recorded so far */
+perf_report perf_collect();
+
+/** Totals for each thread and for each function, with instructions per cycle and misses
+  * per thousand integers */
+void print_perf_report(std::ostream &out, const perf_report &report);
+
+/** Set by perf_instrumentation(); when clear, perf_stripe_scope does nothing else. */
+extern std::atomic<bool> perf_instrumentation_on;
+
+/** Reads the counters for this thread when constructed and again when destroyed, and
+  * records the difference as one stripe, if perf_instrumentation(true) has been called.
+  * Each thread opens its own counters the first time; reading them is a system call,
+  * about a microsecond, which is small next to a stripe. */
+class perf_stripe_scope {
+public:
+	perf_stripe_scope(perf_site s, uint64_t n)
+		: active{perf_instrumentation_on.load(std::memory_order_relaxed)}, site{s}, integers{n}
+		{ if ( active ) { begin(); } }
+	~perf_stripe_scope() { if ( active ) { end(); } }
+private:
+	perf_stripe_scope(const perf_stripe_scope&);
+	perf_stripe_scope& operator=(const perf_stripe_scope&);
+	bool active;
+	perf_site site;
+	uint64_t integers;
+	perf_sample start;
+	void begin();
+	void end();
+};
+
+/** Various testing routines */
+/** Tests that instrumented sieves give the same answers, and that each stripe is recorded */
+bool test28();
+
+#endif // __PERF_COUNTERS_H
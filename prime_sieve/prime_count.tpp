@@ -0,0 +1,415 @@
+/** @file: prime_count.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Counting the primes up to x without sieving all the way to x: the combinatorial
+ *  algorithm of Lagarias, Miller and Odlyzko, with some of the improvements of
+ *  Deleglise and Rivat.
+ */
+
+#ifndef __PRIME_COUNT_TPP
+#define __PRIME_COUNT_TPP
+
+
+#include "sieve.tpp"
+#include "cache_info.h"
+#include "packed_sieve.tpp"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+
+/** Largest r with r*r*r <= n */
+template <typename T>
+T integer_cbrt(const T n)
+{
+	T r = static_cast<T>(std::cbrt(static_cast<double>(n)));
+	while ( r > 0 and r > n / r / r ) { --r; }
+	while ( r+1 <= n / (r+1) / (r+1) ) { ++r; }
+	return r;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class counting_segment code
+// --------------------------------------------------------------------------
+
+/** A segment of the sieve of odd numbers, one bit each, together with the number of bits
+  * set in each block of 512 bits.  Crossing a number off is O(1), and counting how many
+  * numbers are left up to some point adds up the block counts (which is quick, as there
+  * are few of them and the compiler vectorises the loop) and then popcounts within the
+  * block.  This beats a Fenwick tree, as there are many more numbers crossed off than
+  * counts asked for.
+  */
+class counting_segment {
+public:
+	void reset(std::size_t size);
+	inline void remove(std::size_t j);
+	inline uint32_t count(std::size_t j)const;
+	uint32_t total()const { return remaining; }
+private:
+	std::vector<uint64_t> bits;
+	std::vector<uint32_t> blocks;
+	uint32_t remaining;
+};
+
+/** All `size` bits set */
+inline void counting_segment::reset(std::size_t size)
+{
+	remaining = static_cast<uint32_t>(size);
+	std::size_t nwords = (size+63)/64;
+	bits.assign(nwords, ~uint64_t(0));
+	if ( size%64 != 0 ) { bits[nwords-1] = ~uint64_t(0) >> (64 - size%64); }
+	blocks.assign((nwords+7)/8, 512);
+	if ( size%512 != 0 ) { blocks.back() = size%512; }
+}
+
+/** Cross off bit j (if it's still set) */
+inline void counting_segment::remove(std::size_t j)
+{
+	uint64_t mask = uint64_t(1) << (j%64);
+	uint64_t word = bits[j/64];
+	bits[j/64] = word & ~mask;
+	uint32_t was_set = (word & mask) != 0;
+	remaining -= was_set;
+	blocks[j/512] -= was_set;
+}
+
+/** Number of bits set in [0, j] */
+inline uint32_t counting_segment::count(std::size_t j)const
+{
+	uint32_t c = 0;
+	for (std::size_t b = 0; b < j/512; ++b) { c += blocks[b]; }
+	for (std::size_t w = (j/512)*8; w < j/64; ++w) { c += __builtin_popcountll(bits[w]); }
+	return c + __builtin_popcountll( bits[j/64] & (~uint64_t(0) >> (63 - j%64)) );
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class prime_counter<T> code
+// --------------------------------------------------------------------------
+
+/** Computes pi(x), the number of primes <= x, in about O(x^(2/3)) time and O(x^(1/3))
+  * memory.  Let y >= x^(1/3), let p_1=2, p_2=3, ... be the primes and a = pi(y).  Then
+  *   pi(x) = phi(x, a) + a - 1 - P2(x, a),
+  * where phi(x, b) counts the integers in [1, x] not divisible by any of p_1, ..., p_b, and
+  * P2(x, a) is the sum over primes y < p <= sqrt(x) of pi(x/p) - pi(p) + 1.
+  *
+  * Expanding phi(x, b) = phi(x, b-1) - phi(x/p_b, b-1) until the argument gets small
+  * gives (all divisions rounding down)
+  *   phi(x, a) = sum_{n <= y} mu(n) x/n - sum_b sum_m mu(m) phi(x/(m p_b), b-1),
+  * where the second sum is over the "special leaves": y/p_b < m <= y with every prime
+  * factor of m bigger than p_b.  Most special leaves are cheap: if x/(m p_b) < p_b then
+  * phi(...) = 1, and if x/(m p_b) < min(y, p_b^2) then phi(...) = pi(x/(m p_b)) - b + 2,
+  * which is a table lookup.  The remaining "hard" leaves all have x/(m p_b) <= x/y, and
+  * are found by a segmented sieve of [1, x/y] which crosses off p_1, p_2, ... in turn,
+  * answering each phi(v, b-1) just before p_b is crossed off, using the counts kept by
+  * class counting_segment.  The same sieve, once every prime up to sqrt(x/y) has been
+  * crossed off, gives the values of pi(x/p) needed for P2.
+  *
+  * The sieve can be split between threads: each thread takes a run of segments and
+  * counts as if its run started at 1, recording for each b the total weight of the
+  * leaves it found and how many numbers its run left uncrossed.  The counts from the
+  * runs before it are then added back in afterwards.
+  *
+  * `alpha` sets y = alpha * x^(1/3) (0 to choose automatically), and `segment_size` is
+  * the number of integers in each segment of the sieve (0 to choose automatically).
+  * Assumes x is at least 10000 or so; prime_pi() deals with smaller x.
+  */
+template <typename T>
+class prime_counter {
+public:
+	prime_counter(T x, double alpha = 0, T segment_size = 0);
+	uint64_t count(unsigned int threads = 1)const;
+	T get_y()const { return y; }
+private:
+	T x, y, z;
+	uint32_t a, K;          // pi(y), and the number of primes crossed off in the sieve
+	T seg_bits, total_bits; // Odd numbers in each segment, and in [1, z]
+	std::vector<T> primes, bigprimes; // Primes <= y, and primes in (y, sqrt(x)]
+	// pi(n) for n <= y: a bit for each integer, and the count before each word.  This
+	// is much smaller than a table of the values, so stays in cache.
+	std::vector<uint64_t> prime_bits;
+	std::vector<uint32_t> prime_counts;
+	uint32_t pi(T n)const
+		{ return prime_counts[n/64] + __builtin_popcountll(prime_bits[n/64] & (~uint64_t(0) >> (63 - n%64))); }
+	std::vector<int32_t> lpf_mu;      // mu(n) times the least prime factor of n
+	std::vector<T> hard_limit;        // Leaves for p_b are hard if m <= hard_limit[b]
+	struct chunk_result {
+		int64_t sum, p2_sum, p2_queries;
+		std::vector<int64_t> weight, uncrossed; // Indexed by the number of primes crossed off
+	};
+	int64_t ordinary_leaves()const;
+	int64_t easy_leaves(uint32_t first, uint32_t last)const;
+	void hard_leaves(T first_seg, T last_seg, chunk_result &result)const;
+};
+
+template <typename T>
+prime_counter<T>::prime_counter(T xx, double alpha, T segment_size)
+	: x{xx}
+{
+	T cbrt = integer_cbrt(x);
+	if ( alpha <= 0 ) {
+		// Balances the sieve of [1, x/y] against the leaves; found by experiment
+		double l = std::log10(static_cast<double>(x));
+		alpha = std::max(1.0, l * l / 20);
+	}
+	y = static_cast<T>(alpha * cbrt);
+	T sqrt_x = integer_sqrt(x);
+	if ( y <= cbrt ) { y = cbrt + 1; } // So y^3 > x, and then sqrt(x/y) < y
+	if ( y > sqrt_x ) { y = sqrt_x; }
+	z = x / y;
+
+	prime_sieve_list<T> pl(y);
+	primes = std::move(pl.primes);
+	a = primes.size();
+	prime_bits.assign(y/64 + 1, 0);
+	for (auto p : primes) { prime_bits[p/64] |= uint64_t(1) << (p%64); }
+	prime_counts.assign(y/64 + 1, 0);
+	for (T w = 1; w <= y/64; ++w) {
+		prime_counts[w] = prime_counts[w-1] + __builtin_popcountll(prime_bits[w-1]);
+	}
+	// Cross off primes from largest to smallest so the smallest factor is what's left
+	lpf_mu.assign(y+1, INT32_MAX);
+	for (auto it = primes.rbegin(); it != primes.rend(); ++it) {
+		int32_t p = static_cast<int32_t>(*it);
+		for (T m = p; m <= y; m += p) {
+			lpf_mu[m] = ( lpf_mu[m] > 0 ) ? -p : ( lpf_mu[m] < 0 ? p : 0 );
+		}
+		if ( *it <= y / *it ) {
+			for (T m = *it * *it; m <= y; m += *it * *it) { lpf_mu[m] = 0; }
+		}
+	}
+	if ( sqrt_x > y ) {
+		prime_sieve_list<T> big(integer_sqrt(sqrt_x) + 1);
+		bigprimes = big.primes_range(y+1, sqrt_x);
+	}
+
+	hard_limit.assign(a+1, 0);
+	for (uint32_t b = 2; b <= a; ++b) {
+		T p = primes[b-1];
+		hard_limit[b] = std::max(x / p / y, x / p / p / p);
+	}
+	K = pi(integer_sqrt(z));
+
+	if ( segment_size == 0 ) {
+		segment_size = std::max<T>(integer_sqrt(z), default_stripe_size(2));
+	}
+	seg_bits = segment_size / 2;
+	seg_bits += (64 - seg_bits%64) % 64;
+	if ( seg_bits == 0 ) { seg_bits = 64; }
+	total_bits = (z+1) / 2;
+}
+
+/** sum_{n <= y} mu(n) x/n */
+template <typename T>
+int64_t prime_counter<T>::ordinary_leaves()const
+{
+	int64_t sum = 0;
+	for (T n = 1; n <= y; ++n) {
+		if ( lpf_mu[n] > 0 ) { sum += x / n; }
+		else if ( lpf_mu[n] < 0 ) { sum -= x / n; }
+	}
+	return sum;
+}
+
+/** The special leaves for p_b, first <= b < last, which don't need the sieve, with their
+  * sign. */
+template <typename T>
+int64_t prime_counter<T>::easy_leaves(uint32_t first, uint32_t last)const
+{
+	int64_t sum = 0;
+	for (uint32_t b = first; b < last; ++b) {
+		T p = primes[b-1], xp = x / p;
+		if ( b == 1 ) {
+			// phi(v, 0) = v, and m is odd
+			for (T m = y/2 + 1; m <= y; ++m) {
+				if ( (m%2) == 1 and lpf_mu[m] != 0 ) {
+					sum += ( lpf_mu[m] > 0 ) ? -int64_t(xp / m) : int64_t(xp / m);
+				}
+			}
+			continue;
+		}
+		if ( p <= y / p ) {
+			// m can be composite
+			for (T m = std::max(y / p, hard_limit[b]) + 1; m <= y; ++m) {
+				int32_t lm = lpf_mu[m];
+				if ( lm == 0 or T(lm > 0 ? lm : -lm) <= p ) { continue; }
+				T v = xp / m;
+				int64_t phi = ( v < p ) ? 1 : int64_t(pi(v)) - b + 2;
+				sum += ( lm > 0 ) ? -phi : phi;
+			}
+			continue;
+		}
+		// Otherwise m = q is a prime with p < q <= y, and mu(q) = -1
+		T qlo = std::max(p, hard_limit[b]);
+		if ( qlo >= y ) { continue; }
+		T qtrivial = xp / p; // Beyond this, x/(pq) < p
+		if ( qtrivial < y ) {
+			sum += a - pi(std::max(qlo, qtrivial));
+		}
+		T qmax = std::min(y, qtrivial);
+		uint32_t i = pi(qlo);
+		// While q <= sqrt(x/p), x/(pq) >= q, so each q gives a different value of pi(x/(pq))
+		T qsparse = std::min(qmax, integer_sqrt(xp));
+		for (; i < a and primes[i] <= qsparse; ++i) {
+			sum += int64_t(pi(xp / primes[i])) - b + 2;
+		}
+		// After that, pi(x/(pq)) = k for runs of q up to x/(p p_k)
+		while ( i < a and primes[i] <= qmax ) {
+			uint32_t k = pi(xp / primes[i]);
+			T qlast = std::min(qmax, xp / primes[k-1]);
+			uint32_t j = pi(qlast);
+			sum += int64_t(j - i) * (int64_t(k) - b + 2);
+			i = j;
+		}
+	}
+	return sum;
+}
+
+/** Sieve segments [first_seg, last_seg), treating the first as if it were at the start,
+  * and process the hard leaves and P2 terms which fall in them. */
+template <typename T>
+void prime_counter<T>::hard_leaves(T first_seg, T last_seg, chunk_result &result)const
+{
+	result.sum = result.p2_sum = result.p2_queries = 0;
+	result.weight.assign(K+1, 0);
+	result.uncrossed.assign(K+1, 0);
+	counting_segment seg;
+	for (T sn = first_seg; sn < last_seg; ++sn) {
+		T bits = std::min(seg_bits, total_bits - sn*seg_bits);
+		T low = 1 + 2*sn*seg_bits, high = low + 2*bits; // Values in [low, high)
+		seg.reset(bits);
+		int64_t p2_base = result.uncrossed[K];
+		for (uint32_t s = 1; s <= K; ++s) {
+			// p_1, ..., p_s have been crossed off; so answer phi(v, s) for b = s+1
+			uint32_t b = s+1;
+			if ( b <= a ) {
+				T p = primes[b-1];
+				T mhi = std::min(std::min(y, hard_limit[b]), x / p / low);
+				T mlo = std::max(y / p, x / p / high);
+				int64_t sum = 0, weight = 0;
+				if ( p <= y / p ) {
+					for (T m = mhi; m > mlo; --m) {
+						int32_t lm = lpf_mu[m];
+						if ( lm == 0 or T(lm > 0 ? lm : -lm) <= p ) { continue; }
+						int64_t phi = seg.count( (x / p / m - low) / 2 );
+						if ( lm > 0 ) { sum -= phi; --weight; }
+						else { sum += phi; ++weight; }
+					}
+				} else if ( mhi > p ) {
+					if ( mlo < p ) { mlo = p; }
+					for (uint32_t i = pi(mhi); i > 0 and primes[i-1] > mlo; --i) {
+						sum += seg.count( (x / p / primes[i-1] - low) / 2 );
+						++weight;
+					}
+				}
+				// The numbers left in earlier segments of this run also count
+				result.sum += sum + weight * result.uncrossed[s];
+				result.weight[s] += weight;
+			}
+			result.uncrossed[s] += seg.total();
+			if ( s < K ) {
+				T p = primes[s];
+				if ( p >= low and p < high ) { seg.remove((p - low) / 2); }
+				T start = p*p;
+				if ( start < low ) {
+					start = low + p - 1;
+					start -= start % p;
+					if ( (start%2) == 0 ) { start += p; }
+				}
+				for (T j = (start - low) / 2; j < bits; j += p) { seg.remove(j); }
+			}
+		}
+		// All primes up to sqrt(z) crossed off, so what's left is 1 and the primes > p_K
+		auto lo = std::upper_bound(bigprimes.begin(), bigprimes.end(), x / high);
+		auto hi = std::upper_bound(bigprimes.begin(), bigprimes.end(), x / low);
+		for (auto it = lo; it != hi; ++it) {
+			result.p2_sum += p2_base + seg.count( (x / *it - low) / 2 );
+			++result.p2_queries;
+		}
+	}
+}
+
+/** pi(x) */
+template <typename T>
+uint64_t prime_counter<T>::count(unsigned int threads)const
+{
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	T numsegs = (total_bits + seg_bits - 1) / seg_bits;
+	T numchunks = ( threads == 1 ) ? 1 : std::min<T>(numsegs, 8*threads);
+	if ( numchunks == 0 ) { numchunks = 1; }
+	T numeasy = ( threads == 1 ) ? 1 : std::min<T>(a, 8*threads);
+	std::vector<chunk_result> results(numchunks);
+	std::vector<int64_t> easy(numeasy, 0);
+	// Tasks are the runs of the sieve, followed by blocks of the easy leaves
+	std::atomic<T> next_task(0);
+	auto work = [this,&results,&easy,&next_task,numsegs,numchunks,numeasy]() {
+		T c;
+		while ( (c = next_task++) < numchunks + numeasy ) {
+			if ( c < numchunks ) {
+				hard_leaves(numsegs * c / numchunks, numsegs * (c+1) / numchunks, results[c]);
+			} else {
+				c -= numchunks;
+				easy[c] = easy_leaves(1 + uint64_t(a) * c / numeasy, 1 + uint64_t(a) * (c+1) / numeasy);
+			}
+		}
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) {
+		workers.push_back(std::thread(work));
+	}
+	int64_t phi = ordinary_leaves();
+	work();
+	for (auto &w : workers) { w.join(); }
+	for (auto e : easy) { phi += e; }
+
+	// Put back the counts from the chunks before each chunk
+	std::vector<int64_t> base(K+1, 0);
+	int64_t p2 = 0;
+	for (const auto &r : results) {
+		phi += r.sum;
+		for (uint32_t s = 1; s <= K; ++s) {
+			phi += r.weight[s] * base[s];
+		}
+		p2 += r.p2_sum + r.p2_queries * base[K];
+		for (uint32_t s = 1; s <= K; ++s) { base[s] += r.uncrossed[s]; }
+	}
+	// pi(x/p) is (numbers left) - 1 + K, and pi(p) for the i-th big prime is a+i+1
+	int64_t n = bigprimes.size();
+	p2 += n * (int64_t(K) - 1) - n * int64_t(a) - n * (n+1) / 2 + n;
+	return phi + a - 1 - p2;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+
+/** Number of primes <= x, using class prime_counter<T> (or for small x, count_primes). */
+template <typename T>
+uint64_t prime_pi(T x, unsigned int threads = 1)
+{
+	if ( x < 10000 ) { return count_primes<T>(0, x); }
+	prime_counter<T> pc(x);
+	return pc.count(threads);
+}
+
+
+
+/** Various testing routines */
+/** Tests that prime_pi agrees with count_primes */
+bool test14();
+
+
+#endif // __PRIME_COUNT_TPP
@@ -0,0 +1,204 @@
+/** @file: prime_range.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  A range of primes which is sieved a stripe at a time as it's iterated over, so
+ *  never holds more than the small primes and one stripe in memory.
+ */
+
+#ifndef __PRIME_RANGE_TPP
+#define __PRIME_RANGE_TPP
+
+
+#include "sieve.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <memory>
+#include <limits>
+#include <iterator>
+#include <cstddef>
+
+
+// --------------------------------------------------------------------------
+// class prime_iterator<T> code
+// --------------------------------------------------------------------------
+
+/** Forward iterator over the primes in [start, end].
+  * First runs through the small primes held in a prime_sieve_list<T>, and then computes
+  * the sieve a stripe at a time with prime_sieve_list<T>::partial_sieve.  Once a stripe
+  * goes past the square of the largest small prime, the list of small primes is rebuilt
+  * (at least doubling in size) so memory use is O(sqrt(N)) where N is the current prime.
+  * Each stripe is turned into a list of primes, a word at a time, by
+  * sieve_to_list_pushback (see bit_extract.tpp), and the iterator then walks that list.
+  * The small primes and the current stripe's primes are shared between copies of the
+  * iterator, so copying one (as post-increment does) is cheap.
+  */
+template <typename T>
+class prime_iterator {
+public:
+	typedef std::forward_iterator_tag iterator_category;
+	typedef T value_type;
+	typedef std::ptrdiff_t difference_type;
+	typedef const T* pointer;
+	typedef const T& reference;
+
+	prime_iterator();
+	prime_iterator(T start, T end, T stripe_size);
+	reference operator*()const { return current; }
+	pointer operator->()const { return &current; }
+	prime_iterator& operator++();
+	prime_iterator operator++(int);
+	bool operator==(const prime_iterator &other)const;
+	bool operator!=(const prime_iterator &other)const { return !(*this == other); }
+private:
+	T current, end, stripe_size;
+	bool at_end;
+	std::shared_ptr<const prime_sieve_list<T>> small;
+	T small_limit;
+	typename std::vector<T>::size_type small_pos; // Index into small->primes, while in that phase
+	bool in_small;
+	std::shared_ptr<std::vector<T>> stripe;     // The primes in the current stripe
+	T stripe_end;
+	typename std::vector<T>::size_type stripe_pos;
+	void next_stripe();
+	void find_next();
+};
+
+/** Constructs the "end" iterator */
+template <typename T>
+prime_iterator<T>::prime_iterator()
+	: current{0}, end{0}, stripe_size{0}, at_end{true}, small_limit{0}, small_pos{0}, in_small{false},
+	stripe_end{0}, stripe_pos{0}
+{ }
+
+template <typename T>
+prime_iterator<T>::prime_iterator(T start, T e, T ssize)
+	: current{0}, end{e}, stripe_size{ssize}, at_end{false}, small_pos{0}, in_small{true},
+	stripe_end{0}, stripe_pos{0}
+{
+	if ( stripe_size < 16 ) { stripe_size = 16; }
+	// Enough small primes for the first stripe
+	T first_end = start + stripe_size - 1;
+	if ( first_end < start or first_end > end ) { first_end = end; }
+	small_limit = integer_sqrt(first_end) + 1;
+	if ( small_limit < 16 ) { small_limit = 16; }
+	small = std::make_shared<const prime_sieve_list<T>>(small_limit);
+	while ( small_pos < small->primes.size() and small->primes[small_pos] < start ) { ++small_pos; }
+	stripe_end = small_limit;
+	if ( start > small_limit ) { stripe_end = start - 1; }
+	find_next();
+}
+
+/** Sieve the next stripe, which starts just after stripe_end. */
+template <typename T>
+void prime_iterator<T>::next_stripe()
+{
+	if ( stripe_end >= end ) { at_end = true; return; }
+	T s = stripe_end + 1;
+	T e = s + (stripe_size - 1);
+	if ( e < s or e > end ) { e = end; }
+	if ( integer_sqrt(e) > small_limit ) {
+		// partial_sieve would cross off any small prime >= s, so keep the new limit below s
+		T limit = 2*small_limit;
+		if ( limit < integer_sqrt(e) + 1 ) { limit = integer_sqrt(e) + 1; }
+		if ( limit >= s ) { limit = s - 1; }
+		small = std::make_shared<const prime_sieve_list<T>>(limit);
+		small_limit = limit;
+		if ( small_limit <= e / small_limit and small_limit*small_limit < e ) {
+			e = small_limit*small_limit;
+		}
+	}
+	// Reuse the buffer unless a copy of this iterator is still looking at it
+	if ( stripe and stripe.use_count() == 1 ) {
+		stripe->clear();
+	} else {
+		stripe = std::make_shared<std::vector<T>>();
+	}
+	stripe->reserve(prime_count_upper_bound(s, e));
+	small->sieve_to_list_pushback(s, small->partial_sieve(s, e), *stripe);
+	stripe_end = e;
+	stripe_pos = 0;
+}
+
+/** Move `current` on to the next prime (or the first, on construction) */
+template <typename T>
+void prime_iterator<T>::find_next()
+{
+	if ( in_small ) {
+		if ( small_pos < small->primes.size() and small->primes[small_pos] <= end ) {
+			current = small->primes[small_pos++];
+			return;
+		}
+		in_small = false;
+		if ( small_pos < small->primes.size() ) { at_end = true; return; }
+		next_stripe();
+	}
+	while ( !at_end ) {
+		if ( stripe_pos < stripe->size() ) {
+			current = (*stripe)[stripe_pos++];
+			return;
+		}
+		next_stripe();
+	}
+}
+
+template <typename T>
+prime_iterator<T>& prime_iterator<T>::operator++()
+{
+	find_next();
+	return *this;
+}
+
+template <typename T>
+prime_iterator<T> prime_iterator<T>::operator++(int)
+{
+	prime_iterator<T> old(*this);
+	find_next();
+	return old;
+}
+
+template <typename T>
+bool prime_iterator<T>::operator==(const prime_iterator<T> &other)const
+{
+	if ( at_end or other.at_end ) { return at_end == other.at_end; }
+	return current == other.current;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class prime_range<T> code
+// --------------------------------------------------------------------------
+
+/** The primes in [start, end], for use in range-based for loops:
+  *   for (auto p : prime_range<unsigned int>(0, 1000000000)) { ... }
+  * By default there is no upper limit (other than the largest value of T) and the
+  * stripe size is default_stripe_size().
+  */
+template <typename T>
+class prime_range {
+public:
+	prime_range(T start = 0, T end = std::numeric_limits<T>::max(), T stripe_size = 0);
+	prime_iterator<T> begin()const { return prime_iterator<T>(first, last, stripe_size); }
+	prime_iterator<T> end()const { return prime_iterator<T>(); }
+private:
+	T first, last, stripe_size;
+};
+
+template <typename T>
+prime_range<T>::prime_range(T start, T end, T ssize)
+	: first{start}, last{end}, stripe_size{ssize}
+{
+	if ( stripe_size == 0 ) { stripe_size = default_stripe_size(); }
+}
+
+
+
+/** Various testing routines */
+/** Tests that prime_range agrees with prime_list */
+bool test11();
+
+
+#endif // __PRIME_RANGE_TPP
@@ -0,0 +1,176 @@
+/** @file: prime_sum.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  The sum of the primes up to x, without listing them: the method popularised by
+ *  "Lucy_Hedgehog" on the Project Euler forums, in O(x^(3/4)) time.
+ */
+
+#ifndef __PRIME_SUM_TPP
+#define __PRIME_SUM_TPP
+
+
+#include "sieve.tpp"
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <thread>
+#include <algorithm>
+
+
+/** The sums overflow 64 bits from about x = 4*10^9 */
+typedef unsigned __int128 uint128_t;
+
+/** Decimal digits of n, as std::ostream can't print it */
+inline std::string uint128_to_string(uint128_t n)
+{
+	std::string s;
+	do {
+		s.push_back(static_cast<char>('0' + static_cast<int>(n % 10)));
+		n /= 10;
+	} while ( n != 0 );
+	std::reverse(s.begin(), s.end());
+	return s;
+}
+
+/** Call f(a, b) on pieces [a, b) of [first, last), split between `threads` threads.
+  * Small ranges aren't worth starting threads for, and are done on this one. */
+template <typename Func>
+void prime_sum_split(uint64_t first, uint64_t last, unsigned int threads, const Func &f)
+{
+	uint64_t n = last - first;
+	if ( threads <= 1 or n < 32768 ) {
+		f(first, last);
+		return;
+	}
+	std::vector<std::thread> workers;
+	for (unsigned int i=1; i<threads; ++i) {
+		workers.push_back(std::thread(f, first + n * i / threads, first + n * (i+1) / threads));
+	}
+	f(first, first + n / threads);
+	for (auto &w : workers) { w.join(); }
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// prime_sum code
+// --------------------------------------------------------------------------
+
+/** Sum of the primes <= x, using `threads` threads (0 means
+  * std::thread::hardware_concurrency()).
+  *
+  * Let S(v, p) be the sum of the n in [2, v] which are prime or have no prime factor
+  * <= p.  Then S(v, 1) = v(v+1)/2 - 1, S(v, p) = S(v, p-1) if p isn't prime or p^2 > v, and
+  * otherwise crossing off p takes away the multiples of p whose other factors have not
+  * yet been crossed off:
+  *   S(v, p) = S(v, p-1) - p * ( S(v/p, p-1) - S(p-1, p-1) ).
+  * Only the values v = x/k are ever needed, and there are about 2 sqrt(x) of them: with
+  * r = sqrt(x), `small[v]` holds S(v) for v <= r (which fits in 64 bits), and `large[k]`
+  * holds S(x/k) for k <= r.  The answer is S(x, r) = large[1].  The primes up to r come
+  * from prime_sieve_list<uint64_t>.
+  *
+  * Crossing off p works down from the largest v, so that S(v/p) is still the old value
+  * when it is read.  To share this between threads, the v are split into blocks
+  * [p^j, p^(j+1)) (for the small values; the large values similarly by k), each of which
+  * only reads values in the block below.  So the blocks are done one at a time, top down,
+  * and each is split between the threads.
+  */
+template <typename T>
+uint128_t prime_sum(const T xx, unsigned int threads = 1)
+{
+	uint64_t x = xx;
+	if ( x < 2 ) { return 0; }
+	if ( threads == 0 ) { threads = std::thread::hardware_concurrency(); }
+	if ( threads == 0 ) { threads = 1; }
+	uint64_t r = integer_sqrt(x);
+	prime_sieve_list<uint64_t> pl(r < 3 ? 3 : r);
+	std::vector<uint64_t> small(r + 1);
+	std::vector<uint128_t> large(r + 1);
+	for (uint64_t v = 1; v <= r; ++v) { small[v] = v*(v+1)/2 - 1; }
+	for (uint64_t k = 1; k <= r; ++k) {
+		uint128_t m = x / k;
+		large[k] = m*(m+1)/2 - 1;
+	}
+
+	for (uint64_t p : pl.primes) {
+		if ( p > r ) { break; }
+		uint64_t p2 = p*p;
+		uint64_t sp = small[p-1];
+		// large[k], for k <= kmax, reads large[kp] (if kp <= r) or small[x/(kp)]
+		auto update_large = [&small,&large,x,r,p,sp](uint64_t first, uint64_t last) {
+			uint64_t k = first;
+			for (; k < last and k*p <= r; ++k) {
+				large[k] -= p * (large[k*p] - sp);
+			}
+			// Dividing in floating point is much quicker, and is out by at most one while x < 2^53
+			const double xd = static_cast<double>(x);
+			for (; k < last; ++k) {
+				uint64_t d = k*p;
+				uint64_t q;
+				if ( x < (uint64_t(1) << 53) ) {
+					q = static_cast<uint64_t>(xd / static_cast<double>(d));
+					if ( q*d > x ) { --q; } else if ( (q+1)*d <= x ) { ++q; }
+				} else {
+					q = x / d;
+				}
+				large[k] -= static_cast<uint128_t>(p) * (small[q] - sp);
+			}
+		};
+		// So do the blocks (kmax/p^(j+1), kmax/p^j] for j = ..., 1, 0
+		uint64_t kmax = std::min(r, x / p2);
+		std::vector<uint64_t> bounds;
+		for (uint64_t b = kmax; b > 0; b /= p) { bounds.push_back(b); }
+		bounds.push_back(0);
+		for (std::size_t j = bounds.size() - 1; j > 0; --j) {
+			prime_sum_split(bounds[j] + 1, bounds[j-1] + 1, threads, update_large);
+		}
+		// small[v], for p^2 <= v <= r, reads small[v/p]: blocks [p^j, p^(j+1)) from the top
+		auto update_small = [&small,p,sp](uint64_t first, uint64_t last) {
+			for (uint64_t v = first; v < last; ++v) {
+				small[v] -= p * (small[v/p] - sp);
+			}
+		};
+		if ( p2 > r ) { continue; }
+		bounds.clear();
+		for (uint64_t b = p2; b <= r; b *= p) {
+			bounds.push_back(b);
+			if ( b > r / p ) { break; }
+		}
+		bounds.push_back(r + 1);
+		for (std::size_t j = bounds.size() - 1; j > 0; --j) {
+			prime_sum_split(bounds[j-1], std::min(bounds[j], r + 1), threads, update_small);
+		}
+	}
+	return large[1];
+}
+
+/** Sum of all the prime powers p^k <= x, k >= 1: prime_sum(x), and then the squares and
+  * higher powers of the primes up to sqrt(x), of which there are few. */
+template <typename T>
+uint128_t prime_power_sum(const T xx, unsigned int threads = 1)
+{
+	uint64_t x = xx;
+	uint128_t sum = prime_sum(x, threads);
+	if ( x < 4 ) { return sum; }
+	prime_sieve_list<uint64_t> pl(integer_sqrt(x) < 3 ? 3 : integer_sqrt(x));
+	for (uint64_t p : pl.primes) {
+		if ( p > x / p ) { break; }
+		for (uint64_t pk = p*p; ; pk *= p) {
+			sum += pk;
+			if ( pk > x / p ) { break; }
+		}
+	}
+	return sum;
+}
+
+
+
+/** Various testing routines */
+/** Tests prime_sum and prime_power_sum against sums of prime_list */
+bool test24();
+
+
+#endif // __PRIME_SUM_TPP
@@ -0,0 +1,216 @@
+/** @file: prime_table.cpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Saving a table of primes to a compact binary file, and reading it back by memory
+ *  mapping the file, so there's nothing to parse.
+ */
+
+#include "prime_table.h"
+#include "wheel_sieve.tpp"
+#include "cache_info.h"
+
+#include <fstream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// --------------------------------------------------------------------------
+// Writing
+// --------------------------------------------------------------------------
+
+bool write_prime_table(const std::string &filename, uint64_t limit, uint64_t block_bytes)
+{
+	if ( block_bytes == 0 ) { block_bytes = 4096; }
+	wheel_sieve<uint64_t> ws(limit);
+	uint64_t stripe = default_stripe_size(30);
+	for (uint64_t n = 0; n <= limit; n += stripe) {
+		ws.compute_section(n, n + stripe - 1);
+	}
+	const std::vector<uint64_t> &words = ws.get_sieve();
+
+	// Bytes of the sieve, in order, whatever the byte order of the machine
+	uint64_t bitmap_bytes = limit/30 + 1;
+	std::vector<unsigned char> bytes(bitmap_bytes);
+	for (uint64_t k = 0; k < bitmap_bytes; ++k) {
+		bytes[k] = static_cast<unsigned char>( words[k/8] >> ((k%8)*8) );
+	}
+
+	prime_table_header header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, "PRIMETBL", 8);
+	header.version = 1;
+	header.byte_order = 0x01020304;
+	header.limit = limit;
+	header.block_bytes = block_bytes;
+	header.num_blocks = (bitmap_bytes + block_bytes - 1) / block_bytes;
+	header.index_offset = sizeof(prime_table_header);
+	header.bitmap_offset = header.index_offset + 8*(header.num_blocks+1);
+	header.bitmap_bytes = bitmap_bytes;
+
+	std::vector<uint64_t> index(header.num_blocks+1);
+	uint64_t count = 0;
+	for (uint64_t p : {2, 3, 5}) {
+		if ( p <= limit ) { ++count; }
+	}
+	for (uint64_t b = 0; b < header.num_blocks; ++b) {
+		index[b] = ( b==0 ) ? 0 : count;
+		uint64_t end = std::min(bitmap_bytes, (b+1)*block_bytes);
+		for (uint64_t k = b*block_bytes; k < end; ++k) {
+			count += __builtin_popcount(bytes[k]);
+		}
+	}
+	index[header.num_blocks] = count;
+
+	std::ofstream file(filename, std::ios::out | std::ios::binary);
+	if ( !file ) { return false; }
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(index.data()), 8*index.size());
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	return static_cast<bool>(file);
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class prime_table code
+// --------------------------------------------------------------------------
+
+prime_table::prime_table()
+	: data{nullptr}, length{0}, header{nullptr}, index{nullptr}, bitmap{nullptr}
+#ifdef _WIN32
+	, file_handle{nullptr}, map_handle{nullptr}
+#endif
+{ }
+
+prime_table::~prime_table()
+{
+	close();
+}
+
+/** Map the file, and check the header makes sense.  Returns false on any failure. */
+bool prime_table::open(const std::string &filename)
+{
+	close();
+#ifdef _WIN32
+	HANDLE fh = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if ( fh == INVALID_HANDLE_VALUE ) { return false; }
+	LARGE_INTEGER size;
+	if ( !GetFileSizeEx(fh, &size) or size.QuadPart == 0 ) { CloseHandle(fh); return false; }
+	HANDLE mh = CreateFileMappingA(fh, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if ( mh == nullptr ) { CloseHandle(fh); return false; }
+	void *ptr = MapViewOfFile(mh, FILE_MAP_READ, 0, 0, 0);
+	if ( ptr == nullptr ) { CloseHandle(mh); CloseHandle(fh); return false; }
+	file_handle = fh;
+	map_handle = mh;
+	length = static_cast<std::size_t>(size.QuadPart);
+#else
+	int fd = ::open(filename.c_str(), O_RDONLY);
+	if ( fd < 0 ) { return false; }
+	struct stat st;
+	if ( fstat(fd, &st) != 0 or st.st_size == 0 ) { ::close(fd); return false; }
+	void *ptr = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	::close(fd); // The mapping keeps the file open
+	if ( ptr == MAP_FAILED ) { return false; }
+	length = st.st_size;
+#endif
+	data = static_cast<const unsigned char*>(ptr);
+	header = reinterpret_cast<const prime_table_header*>(data);
+	if ( length < sizeof(prime_table_header)
+		or std::memcmp(header->magic, "PRIMETBL", 8) != 0
+		or header->version != 1 or header->byte_order != 0x01020304
+		or header->block_bytes == 0
+		or header->bitmap_bytes != header->limit/30 + 1
+		or header->num_blocks != (header->bitmap_bytes + header->block_bytes - 1) / header->block_bytes
+		or header->index_offset + 8*(header->num_blocks+1) > header->bitmap_offset
+		or header->bitmap_offset + header->bitmap_bytes > length ) {
+		close();
+		return false;
+	}
+	index = reinterpret_cast<const uint64_t*>(data + header->index_offset);
+	bitmap = data + header->bitmap_offset;
+	return true;
+}
+
+void prime_table::close()
+{
+	if ( data == nullptr ) { return; }
+#ifdef _WIN32
+	UnmapViewOfFile(data);
+	CloseHandle(map_handle);
+	CloseHandle(file_handle);
+	file_handle = map_handle = nullptr;
+#else
+	munmap(const_cast<unsigned char*>(data), length);
+#endif
+	data = nullptr;
+	length = 0;
+	header = nullptr;
+	index = nullptr;
+	bitmap = nullptr;
+}
+
+bool prime_table::is_prime(uint64_t n)const
+{
+	if ( n==2 or n==3 or n==5 ) { return n <= header->limit; }
+	if ( n > header->limit ) { return false; }
+	unsigned int bit = wheel30_bit[n%30];
+	if ( bit == 8 ) { return false; }
+	return ( bitmap[n/30] >> bit ) & 1;
+}
+
+/** Number of primes <= n (up to the limit of the table) */
+uint64_t prime_table::count(uint64_t n)const
+{
+	if ( n > header->limit ) { n = header->limit; }
+	uint64_t k = n/30;
+	uint64_t b = k / header->block_bytes;
+	uint64_t c = index[b];
+	if ( b == 0 ) {
+		for (uint64_t p : {2, 3, 5}) {
+			if ( p <= n ) { ++c; }
+		}
+	}
+	for (uint64_t j = b*header->block_bytes; j < k; ++j) {
+		c += __builtin_popcount(bitmap[j]);
+	}
+	// Bits of byte k for residues <= n%30
+	unsigned int below = 0;
+	while ( below < 8 and wheel30_residues[below] <= n%30 ) { ++below; }
+	c += __builtin_popcount( bitmap[k] & ((1u << below) - 1) );
+	return c;
+}
+
+/** The k-th prime, so nth_prime(1) == 2; returns 0 if k is 0 or more than size() */
+uint64_t prime_table::nth_prime(uint64_t k)const
+{
+	if ( k == 0 or k > size() ) { return 0; }
+	if ( k <= 3 ) { return k==1 ? 2 : (k==2 ? 3 : 5); }
+	// Last block b with index[b] < k
+	const uint64_t *pos = std::upper_bound(index, index + header->num_blocks + 1, k-1);
+	uint64_t b = (pos - index) - 1;
+	uint64_t remaining = k - index[b];
+	if ( b == 0 ) { remaining -= 3; }
+	for (uint64_t j = b*header->block_bytes; ; ++j) {
+		unsigned int byte = bitmap[j];
+		unsigned int c = __builtin_popcount(byte);
+		if ( c < remaining ) {
+			remaining -= c;
+			continue;
+		}
+		while ( --remaining > 0 ) { byte &= byte - 1; }
+		return 30*j + wheel30_residues[__builtin_ctz(byte)];
+	}
+}
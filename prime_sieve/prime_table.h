@@ -0,0 +1,97 @@
+/** @file: prime_table.h
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Saving a table of primes to a compact binary file, and reading it back by memory
+ *  mapping the file, so there's nothing to parse.
+ */
+
+#ifndef __PRIME_TABLE_H
+#define __PRIME_TABLE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <initializer_list>
+
+/** File layout:
+  *   - this header (64 bytes);
+  *   - the index: num_blocks+1 uint64_t values, entry b being the number of primes less
+  *     than 30*block_bytes*b (so the last entry is the total);
+  *   - the sieve, at bitmap_offset: one byte per 30 integers, exactly as in class
+  *     wheel_sieve<T>, so bit i of byte k is set if 30k+wheel30_residues[i] is prime.
+  *     The primes 2, 3 and 5 are implicit.
+  * Integers are stored in the byte order of the machine which wrote the file; a reader
+  * with a different byte order will see the wrong `byte_order` and refuse the file.
+  */
+struct prime_table_header {
+	char magic[8];           // "PRIMETBL"
+	uint32_t version;        // 1
+	uint32_t byte_order;     // 0x01020304
+	uint64_t limit;          // Table covers [0, limit]
+	uint64_t block_bytes;    // Sieve bytes per index entry
+	uint64_t num_blocks;
+	uint64_t index_offset;
+	uint64_t bitmap_offset;
+	uint64_t bitmap_bytes;
+};
+
+/** Sieve up to `limit` with class wheel_sieve and save to `filename`.  Each block of
+  * `block_bytes` bytes of the sieve covers 30*block_bytes integers.  Returns false if
+  * the file couldn't be written. */
+bool write_prime_table(const std::string &filename, uint64_t limit, uint64_t block_bytes = 4096);
+
+/** Read-only access to a file written by write_prime_table(), which is memory mapped. */
+class prime_table {
+public:
+	prime_table();
+	~prime_table();
+	bool open(const std::string &filename);
+	void close();
+	bool is_open()const { return data != nullptr; }
+	uint64_t limit()const { return header->limit; }
+	uint64_t size()const { return index[header->num_blocks]; }
+	bool is_prime(uint64_t n)const;
+	uint64_t count(uint64_t n)const;
+	uint64_t nth_prime(uint64_t k)const;
+	template <typename Func>
+	void for_each(uint64_t lo, uint64_t hi, Func f)const;
+private:
+	prime_table(const prime_table&);
+	prime_table& operator=(const prime_table&);
+	const unsigned char *data;
+	std::size_t length;
+	const prime_table_header *header;
+	const uint64_t *index;
+	const unsigned char *bitmap;
+#ifdef _WIN32
+	void *file_handle, *map_handle;
+#endif
+};
+
+/** Calls f(p) for each prime p in [lo, hi], in order. */
+template <typename Func>
+void prime_table::for_each(uint64_t lo, uint64_t hi, Func f)const
+{
+	static const unsigned int residues[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+	if ( hi > header->limit ) { hi = header->limit; }
+	if ( lo > hi ) { return; }
+	for (uint64_t p : {2, 3, 5}) {
+		if ( p >= lo and p <= hi ) { f(p); }
+	}
+	for (uint64_t k = lo/30; k <= hi/30; ++k) {
+		unsigned int byte = bitmap[k];
+		while ( byte != 0 ) {
+			uint64_t p = 30*k + residues[__builtin_ctz(byte)];
+			if ( p > hi ) { return; }
+			if ( p >= lo ) { f(p); }
+			byte &= byte - 1;
+		}
+	}
+}
+
+/** Various testing routines */
+/** Tests that a prime_table written and read back agrees with prime_list */
+bool test13();
+
+#endif // __PRIME_TABLE_H
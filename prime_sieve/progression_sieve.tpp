@@ -0,0 +1,198 @@
+/** @file: progression_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  Sieving just the numbers a, a+q, a+2q, ..., to find the primes p = a mod q without
+ *  sieving the other residue classes.
+ */
+
+#ifndef __PROGRESSION_SIEVE_TPP
+#define __PROGRESSION_SIEVE_TPP
+
+
+#include "sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+
+/** x^{-1} mod m, for gcd(x, m) = 1, by the extended Euclidean algorithm */
+inline uint64_t inverse_mod(uint64_t x, uint64_t m)
+{
+	int64_t r0 = static_cast<int64_t>(m), r1 = static_cast<int64_t>(x % m);
+	int64_t s0 = 0, s1 = 1;
+	while ( r1 != 0 ) {
+		int64_t t = r0 / r1;
+		int64_t r = r0 - t*r1; r0 = r1; r1 = r;
+		int64_t s = s0 - t*s1; s0 = s1; s1 = s;
+	}
+	return static_cast<uint64_t>( s0 < 0 ? s0 + static_cast<int64_t>(m) : s0 ) % m;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class progression_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Sieve of the progression a + kq, k = 0, 1, 2, ..., up to `len`, one bit for each k.
+  * For each sieving prime p (up to sqrt(len), from prime_sieve_list<T>) not dividing q, the
+  * multiples of p in the progression are those with k = -a q^{-1} mod p, one in every p;
+  * the residue is worked out once, in the constructor, with the modular inverse.  So a
+  * segment of n bits costs about n log log len / 2 operations plus one remainder for each
+  * sieving prime, and covers nq integers: sieving the whole number line and keeping one
+  * residue class would be about q/2 times the work (the odds-only sieves skip the even
+  * numbers already), and q times the memory.
+  *
+  * If gcd(a, q) > 1 then the only possible prime is a itself (or q, if a = 0).
+  */
+template <typename T>
+class progression_sieve {
+public:
+	progression_sieve(const T q, const T a, const T len, const T segment_size = 0);
+	std::vector<T> primes_range(T start, T end)const;
+	std::vector<T> prime_list()const { return primes_range(0, length); }
+	uint64_t count(T start, T end)const;
+private:
+	T q, a, length;
+	T phi;                      // Euler's phi(q), for reserving the list of primes
+	bool coprime;
+	prime_sieve_list<T> small;
+	std::vector<T> residues;    // Multiples of primes[i] are a + kq, k = residues[i] mod primes[i]
+	uint64_t segment_bits;
+	template <typename Func>
+	void sieve(T start, T end, Func visit)const;
+};
+
+/** Constructor: a is reduced mod q.  A segment has about `segment_size` bits (not integers,
+  * as in the other classes: it is the memory that matters), by default filling the L1 data
+  * cache. */
+template <typename T>
+progression_sieve<T>::progression_sieve(const T qq, const T aa, const T len, const T segment_size)
+	: q{qq}, a{static_cast<T>(aa % qq)}, length{len},
+	  small( integer_sqrt(len) + 1 < 3 ? 3 : integer_sqrt(len) + 1 )
+{
+	T g = q, h = a;
+	while ( h != 0 ) { T t = g % h; g = h; h = t; }
+	coprime = ( g == 1 );
+	// phi(q) by trial division; if q > len at most one term is in range, so q will do
+	phi = q;
+	if ( q <= len ) {
+		T m = q;
+		for (T d = 2; d <= m / d; ++d) {
+			if ( m % d != 0 ) { continue; }
+			phi -= phi / d;
+			while ( m % d == 0 ) { m /= d; }
+		}
+		if ( m > 1 ) { phi -= phi / m; }
+	}
+	residues.resize(small.primes.size());
+	for (std::size_t i = 0; i < small.primes.size(); ++i) {
+		uint64_t p = small.primes[i];
+		if ( q % p == 0 ) { residues[i] = 0; continue; }
+		uint64_t minus_a = (p - a % p) % p;
+		residues[i] = static_cast<T>(minus_a * inverse_mod(q % p, p) % p);
+	}
+	segment_bits = ( segment_size == 0 ) ? uint64_t(8) * cache_info().l1d : segment_size;
+	segment_bits += 63;
+	segment_bits -= segment_bits % 64;
+}
+
+/** Sieve a + kq for k from kfirst to klast (inclusive), a segment at a time, calling
+  * visit(words, bits, k) for each segment, of `bits` bits starting at k */
+template <typename T>
+template <typename Func>
+void progression_sieve<T>::sieve(T kfirst, T klast, Func visit)const
+{
+	std::vector<uint64_t> words(segment_bits / 64);
+	for (uint64_t k0 = kfirst; k0 <= klast; k0 += segment_bits) {
+		uint64_t bits = std::min<uint64_t>(segment_bits, uint64_t(klast) - k0 + 1);
+		uint64_t nwords = (bits + 63) / 64;
+		std::fill(words.begin(), words.begin() + nwords, ~uint64_t(0));
+		if ( bits%64 != 0 ) { words[nwords-1] = ~uint64_t(0) >> (64 - bits%64); }
+		uint64_t end = a + (k0 + bits - 1) * q;
+		for (std::size_t i = 0; i < small.primes.size(); ++i) {
+			uint64_t p = small.primes[i];
+			if ( p > end / p ) { break; }
+			if ( q % p == 0 ) { continue; }
+			// First k >= k0 with a + kq >= p^2 and a + kq = 0 mod p
+			uint64_t klo = ( p*p <= a ) ? 0 : (p*p - a + q - 1) / q;
+			if ( klo < k0 ) { klo = k0; }
+			uint64_t j = klo + (residues[i] + p - klo % p) % p - k0;
+			for (; j < bits; j += p) {
+				words[j/64] &= ~(uint64_t(1) << (j%64));
+			}
+		}
+		if ( k0 == 0 and a <= 1 ) {
+			words[0] &= ~uint64_t(1);                           // 0 or 1
+			if ( a == 0 and q == 1 and bits > 1 ) { words[0] &= ~uint64_t(2); } // 1
+		}
+		visit(words.data(), bits, k0);
+		if ( k0 + bits > klast ) { break; }
+	}
+}
+
+/** The primes = a mod q in [start, end] (with end reduced to the length) */
+template <typename T>
+std::vector<T> progression_sieve<T>::primes_range(T start, T end)const
+{
+	std::vector<T> primes;
+	if ( end > length ) { end = length; }
+	if ( ! coprime ) {
+		// Every a + kq is divisible by gcd(a, q), so only the smallest one can be prime
+		T c = ( a == 0 ) ? q : a;
+		bool prime = c >= 2;
+		for (T d = 2; prime and d <= c / d; ++d) { prime = c % d != 0; }
+		if ( prime and start <= c and c <= end ) { primes.push_back(c); }
+		return primes;
+	}
+	if ( end < start or end < a ) { return primes; }
+	T kfirst = ( start <= a ) ? 0 : (start - a + q - 1) / q;
+	T klast = (end - a) / q;
+	if ( kfirst > klast ) { return primes; }
+	// About 1/phi(q) of the primes are = a mod q, for each a coprime to q
+	primes.reserve(prime_count_upper_bound(start, end) / phi + 16);
+	sieve(kfirst, klast, [&primes,this](const uint64_t *words, uint64_t bits, uint64_t k0) {
+		extract_bits_pushback(words, static_cast<std::size_t>(bits), static_cast<T>(a + k0*q), q, primes);
+	});
+	return primes;
+}
+
+/** The number of primes = a mod q in [start, end] */
+template <typename T>
+uint64_t progression_sieve<T>::count(T start, T end)const
+{
+	if ( ! coprime ) { return primes_range(start, end).size(); }
+	if ( end > length ) { end = length; }
+	if ( end < start or end < a ) { return 0; }
+	T kfirst = ( start <= a ) ? 0 : (start - a + q - 1) / q;
+	T klast = (end - a) / q;
+	if ( kfirst > klast ) { return 0; }
+	uint64_t total = 0;
+	sieve(kfirst, klast, [&total](const uint64_t *words, uint64_t bits, uint64_t) {
+		for (uint64_t w = 0; w < (bits + 63) / 64; ++w) { total += __builtin_popcountll(words[w]); }
+	});
+	return total;
+}
+
+/** The primes p <= len with p = a mod q */
+template <typename T>
+std::vector<T> progression_prime_list(const T q, const T a, const T len)
+{
+	progression_sieve<T> ps(q, a, len);
+	return ps.prime_list();
+}
+
+
+
+/** Various testing routines */
+/** Tests progression_sieve against filtering prime_list */
+bool test26();
+
+
+#endif // __PROGRESSION_SIEVE_TPP
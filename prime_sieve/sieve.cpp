@@ -6,6 +6,30 @@
  */
 
 #include "sieve.tpp"
+#include "wheel_sieve.tpp"
+#include "parallel_sieve.tpp"
+#include "cache_info.h"
+#include "bucket_sieve.tpp"
+#include "prime_range.tpp"
+#include "packed_sieve.tpp"
+#include "prime_table.h"
+#include "prime_count.tpp"
+#include "bit_extract.tpp"
+#include "atkin_sieve.tpp"
+#include "multiplicative_sieve.tpp"
+#include "growable_sieve.tpp"
+#include "lazy_sieve.tpp"
+#include "compressed_list.tpp"
+#include "prime_sum.tpp"
+#include "gap_statistics.tpp"
+#include "progression_sieve.tpp"
+#include "nth_prime.tpp"
+#include "batch_query.tpp"
+#include "width_dispatch.tpp"
+#include "perf_counters.h"
+
+#include <cstdio>
+#include <algorithm>
 
 #include <iostream>
 using std::cout;
@@ -116,6 +140,1153 @@ bool test6()
 			return false;
 		}
 	}
+	return true;
+}
+
+/** Tests that prime_list and class wheel_sieve return the same lists */
+bool test7()
+{
+	for (unsigned int len=1; len<=10000; ++len) {
+		auto plist = prime_list(len);
+		wheel_sieve<unsigned int> ws(len);
+		for (unsigned int n=0; n<=len; n+=95) {
+			ws.compute_section(n, n+94);
+		}
+		auto plist2 = ws.prime_list();
+		if ( len < 2 ) { plist.clear(); }
+		if ( plist != plist2 ) {
+			cout << "test7 fail: len=" << len << endl;
+			return false;
+		}
+		for (unsigned int p=0; p<=len+30; ++p) {
+			if ( ws.is_prime(p) != (p<=len and is_prime_slow_test(p) and p>1) ) {
+				cout << "test7 fail: len=" << len << " is_prime(" << p << ")" << endl;
+				return false;
+			}
+		}
+	}
+	// A section ending at the largest unsigned int mustn't disturb the rest of the sieve
+	const unsigned int top = std::numeric_limits<unsigned int>::max();
+	wheel_sieve<unsigned int> ws(top);
+	ws.compute_section(0, 3000000);
+	ws.compute_section(top - 100, top);
+	auto plist = prime_list(3000000u);
+	std::size_t count = 0;
+	for (unsigned int n=0; n<=3000000; ++n) {
+		if ( ws.is_prime(n) ) { ++count; }
+	}
+	if ( count != plist.size() ) {
+		cout << "test7 fail: section ending at " << top << " changed the primes below 3000000" << endl;
+		return false;
+	}
+	for (unsigned int n = top - 100; n != 0; ++n) {
+		if ( ws.is_prime(n) != is_prime_slow_test(n) ) {
+			cout << "test7 fail: is_prime(" << n << ") near " << top << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Tests that parallel_compute with sieve_stripe and wheel_sieve agrees with prime_list */
+bool test8()
+{
+	for (unsigned int len=100; len<=40000; len+=97) {
+		auto plist = prime_list(len);
+		for (unsigned int threads=1; threads<=5; threads+=2) {
+			sieve_stripe<unsigned int> ss(len);
+			auto report = parallel_compute(ss, len, threads, 1024u);
+			unsigned int total = 0;
+			for (auto n : report.segments) { total += n; }
+			if ( ss.prime_list() != plist or report.segments.size() != threads
+				or total != (len-3)/1024+1 ) {
+				cout << "test8 fail: sieve_stripe, len=" << len << " threads=" << threads << endl;
+				return false;
+			}
+			wheel_sieve<unsigned int> ws(len);
+			parallel_compute(ws, len, threads, 1920u);
+			if ( ws.prime_list() != plist ) {
+				cout << "test8 fail: wheel_sieve, len=" << len << " threads=" << threads << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/** Tests that the cache sizes are sensible, and that calibration is saved and reloaded */
+bool test9()
+{
+	auto cg = detect_cache_geometry();
+	if ( cg.l1d < 1024 or cg.l2 < cg.l1d or cg.line < 16 or (cg.line & (cg.line-1)) != 0 ) {
+		cout << "test9 fail: l1d=" << cg.l1d << " l2=" << cg.l2 << " line=" << cg.line << endl;
+		return false;
+	}
+	if ( default_stripe_size() != cache_info().l1d * 16 or default_stripe_size(30) != cache_info().l1d * 30 ) {
+		cout << "test9 fail: default stripe size " << default_stripe_size() << endl;
+		return false;
+	}
+	const char *filename = "test9_stripe_size.cfg";
+	unsigned int first = calibrate_stripe_size(filename, true);
+	unsigned int second = calibrate_stripe_size(filename);
+	std::remove(filename);
+	if ( first != second or first != default_stripe_size() or first % 16 != 0 ) {
+		cout << "test9 fail: calibrated " << first << " then loaded " << second << endl;
+		return false;
+	}
+	return true;
+}
+
+/** Tests that prime_list_bucket agrees with prime_list and prime_sieve_list<T>::primes_range */
+bool test10()
+{
+	auto plist = prime_list(200000u);
+	std::vector<unsigned int> ends{0, 1, 2, 3, 10, 100, 5000, 100000};
+	for (unsigned int start=0; start<=2000; start+=13) {
+		for (auto e : ends) {
+			for (unsigned int segsize : {128u, 1000u, 100000u}) {
+				std::vector<unsigned int> expected;
+				for (auto p : plist) {
+					if ( p >= start and p <= start+e ) { expected.push_back(p); }
+				}
+				if ( prime_list_bucket(start, start+e, segsize) != expected ) {
+					cout << "test10 fail: start=" << start << " end=" << start+e << " segsize=" << segsize << endl;
+					return false;
+				}
+			}
+		}
+	}
+	// 64-bit ranges; small segments so almost all sieving primes go into buckets
+	std::vector<uint64_t> starts{1000000000000ull, 999999999999999ull, 4294967296ull - 1000000};
+	for (auto start : starts) {
+		uint64_t end = start + 2000000;
+		prime_sieve_list<uint64_t> pl( integer_sqrt(end) + 1 );
+		auto expected = pl.primes_range(start, end);
+		if ( prime_list_bucket<uint64_t>(start, end, 4096) != expected
+			or prime_list_bucket<uint64_t>(start, end) != expected ) {
+			cout << "test10 fail: start=" << start << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Tests that prime_range agrees with prime_list */
+bool test11()
+{
+	auto plist = prime_list(300000u);
+	for (unsigned int start=0; start<=3000; start+=29) {
+		for (unsigned int end : {start, start+1, start+100, start+20000, start+200000}) {
+			for (unsigned int stripe : {16u, 100u, 4096u, 0u}) {
+				std::vector<unsigned int> expected, got;
+				for (auto p : plist) {
+					if ( p >= start and p <= end ) { expected.push_back(p); }
+				}
+				for (auto p : prime_range<unsigned int>(start, end, stripe)) { got.push_back(p); }
+				if ( got != expected ) {
+					cout << "test11 fail: start=" << start << " end=" << end << " stripe=" << stripe << endl;
+					return false;
+				}
+			}
+		}
+	}
+	// No upper limit: the small primes have to keep growing
+	std::vector<unsigned int> got;
+	for (auto p : prime_range<unsigned int>(0, std::numeric_limits<unsigned int>::max(), 64)) {
+		if ( got.size() == 20000 ) { break; }
+		got.push_back(p);
+	}
+	if ( got != std::vector<unsigned int>(plist.begin(), plist.begin() + 20000) ) {
+		cout << "test11 fail: unbounded" << endl;
+		return false;
+	}
+	// Copies are independent, and reach the end
+	prime_range<uint64_t> r(4294967290ull, 4294967400ull);
+	auto expected = prime_sieve_list<uint64_t>(65600).primes_range(4294967290ull, 4294967400ull);
+	auto it = r.begin();
+	auto copy = it++;
+	if ( *copy != expected[0] or *it != expected[1]
+		or static_cast<std::size_t>(std::distance(r.begin(), r.end())) != expected.size() ) {
+		cout << "test11 fail: 64-bit iterator" << endl;
+		return false;
+	}
+	// A copy keeps its place while the original moves on through later stripes
+	prime_range<unsigned int> small_stripes(0, 100000, 64);
+	auto a = small_stripes.begin();
+	for (int i = 0; i < 500; ++i) { ++a; }
+	auto b = a;
+	std::vector<unsigned int> tail_a, tail_b;
+	for (; a != small_stripes.end(); a++) { tail_a.push_back(*a); }
+	for (; b != small_stripes.end(); ++b) { tail_b.push_back(*b); }
+	auto last = std::upper_bound(plist.begin(), plist.end(), 100000u);
+	if ( tail_a != std::vector<unsigned int>(plist.begin() + 500, last) or tail_b != tail_a ) {
+		cout << "test11 fail: copies" << endl;
+		return false;
+	}
+	return true;
+}
+
+/** Tests that count_primes agrees with prime_list */
+bool test12()
+{
+	auto plist = prime_list(300000u);
+	for (unsigned int lo=0; lo<=3000; lo+=31) {
+		for (unsigned int hi : {lo, lo+1, lo+2, lo+150, lo+20000, lo+200000}) {
+			uint64_t expected = 0;
+			for (auto p : plist) {
+				if ( p >= lo and p <= hi ) { ++expected; }
+			}
+			for (unsigned int threads : {1u, 3u}) {
+				for (unsigned int segsize : {128u, 1000u, 0u}) {
+					if ( count_primes(lo, hi, threads, segsize) != expected ) {
+						cout << "test12 fail: lo=" << lo << " hi=" << hi << " threads=" << threads
+							<< " segsize=" << segsize << endl;
+						return false;
+					}
+				}
+			}
+		}
+	}
+	if ( count_primes(0u, 100000000u, 4) != 5761455 ) {
+		cout << "test12 fail: pi(10^8)" << endl;
+		return false;
+	}
+	uint64_t lo = 1000000000000ull, hi = lo + 1000000;
+	if ( count_primes(lo, hi, 2, uint64_t(4096)) != prime_list_bucket(lo, hi).size() ) {
+		cout << "test12 fail: 64-bit range" << endl;
+		return false;
+	}
+	return true;
+}
+
+/** Tests that a prime_table written and read back agrees with prime_list */
+bool test13()
+{
+	const char *filename = "test13_primes.bin";
+	for (uint64_t limit : {0, 1, 2, 3, 4, 5, 6, 7, 29, 30, 31, 100, 1000, 30*64, 30*64+7, 123457}) {
+		for (uint64_t block_bytes : {1, 3, 64}) {
+			if ( ! write_prime_table(filename, limit, block_bytes) ) {
+				cout << "test13 fail: can't write " << filename << endl;
+				return false;
+			}
+			prime_table table;
+			if ( ! table.open(filename) ) {
+				cout << "test13 fail: can't open " << filename << endl;
+				return false;
+			}
+			auto plist = prime_list<uint64_t>(limit < 3 ? 3 : limit);
+			while ( !plist.empty() and plist.back() > limit ) { plist.pop_back(); }
+			bool ok = ( table.limit() == limit and table.size() == plist.size() );
+			for (uint64_t k = 0; k < plist.size() and ok; ++k) {
+				ok = ( table.nth_prime(k+1) == plist[k] );
+			}
+			ok = ok and table.nth_prime(0) == 0 and table.nth_prime(plist.size()+1) == 0;
+			uint64_t c = 0;
+			for (uint64_t n = 0; n <= limit + 40 and ok; ++n) {
+				bool prime = ( n <= limit and n > 1 and is_prime_slow_test(n) );
+				if ( prime ) { ++c; }
+				ok = ( table.is_prime(n) == prime and table.count(n) == c );
+			}
+			std::vector<uint64_t> got;
+			table.for_each(0, limit, [&got](uint64_t p) { got.push_back(p); });
+			ok = ok and got == plist;
+			got.clear();
+			table.for_each(limit/3, limit/2 + 11, [&got](uint64_t p) { got.push_back(p); });
+			for (auto p : got) { ok = ok and p >= limit/3 and p <= limit/2+11 and table.is_prime(p); }
+			ok = ok and got.size() == table.count(limit/2 + 11) - (limit/3 == 0 ? 0 : table.count(limit/3 - 1));
+			if ( !ok ) {
+				cout << "test13 fail: limit=" << limit << " block_bytes=" << block_bytes << endl;
+				std::remove(filename);
+				return false;
+			}
+		}
+	}
+	std::remove(filename);
+	prime_table table;
+	if ( table.open(filename) or table.open("sieve.cpp") ) {
+		cout << "test13 fail: opened a missing or invalid file" << endl;
+		return false;
+	}
+	return true;
+}
+
+/** Tests that prime_pi agrees with count_primes */
+bool test14()
+{
+	for (unsigned int x = 0; x < 3000000; x += ( x < 20000 ? 997 : 99991 )) {
+		uint64_t expected = count_primes(0u, x);
+		if ( prime_pi(x) != expected ) {
+			cout << "test14 fail: x=" << x << endl;
+			return false;
+		}
+		if ( x < 10000 ) { continue; }
+		for (double alpha : {1.0, 3.0, 100.0}) {
+			for (unsigned int segsize : {128u, 0u}) {
+				for (unsigned int threads : {1u, 3u}) {
+					prime_counter<unsigned int> pc(x, alpha, segsize);
+					if ( pc.count(threads) != expected ) {
+						cout << "test14 fail: x=" << x << " alpha=" << alpha << " segsize=" << segsize
+							<< " threads=" << threads << endl;
+						return false;
+					}
+				}
+			}
+		}
+	}
+	if ( prime_pi(4000000000u) != 189961812 ) {
+		cout << "test14 fail: pi(4*10^9)" << endl;
+		return false;
+	}
+	if ( prime_pi(uint64_t(100000000000), 3) != 4118054813ull ) {
+		cout << "test14 fail: pi(10^11)" << endl;
+		return false;
+	}
+	return true;
+}
 
+/** Tests extract_bits_pushback, and the portable std::vector<bool> version, against
+  * decoding one bit at a time */
+template <typename T>
+bool test15_type(const std::vector<uint64_t> &words, std::size_t nbits, T start, T step)
+{
+	std::vector<T> expected(3, 7), got(3, 7);
+	std::vector<bool> bools(nbits);
+	for (std::size_t i = 0; i < nbits; ++i) {
+		bools[i] = (words[i/64] >> (i%64)) & 1;
+		if ( bools[i] ) { expected.push_back(start + step * T(i)); }
+	}
+	extract_bits_pushback(words.data(), nbits, start, step, got);
+	if ( got != expected ) { return false; }
+	got.assign(3, 7);
+	extract_bits_pushback(bools, start, step, got);
+	if ( got != expected ) { return false; }
+	// The path for standard libraries other than libstdc++, whichever this is
+	got.assign(3, 7);
+	extract_bits_pushback_portable(bools, start, step, got);
+	return got == expected;
+}
 
+bool test15()
+{
+	uint64_t state = 12345;
+	for (std::size_t nbits = 0; nbits < 400; nbits += ( nbits < 130 ? 1 : 17 )) {
+		for (int density = 0; density < 4; ++density) {
+			std::vector<uint64_t> words(nbits/64 + 1);
+			for (auto &w : words) {
+				state = state * 6364136223846793005ull + 1442695040888963407ull;
+				w = state;
+				if ( density == 0 ) { w = 0; }
+				if ( density == 1 ) { w &= w >> 7; }
+				if ( density == 3 ) { w = ~uint64_t(0); }
+			}
+			if ( ! test15_type<unsigned int>(words, nbits, 3u, 2u)
+				or ! test15_type<int>(words, nbits, -101, 2)
+				or ! test15_type<uint64_t>(words, nbits, 1000000000001ull, 2)
+				or ! test15_type<unsigned short>(words, nbits, 5, 2)
+				or ! test15_type<uint64_t>(words, nbits, 0, 6)
+				or ! test15_type<uint64_t>(words, nbits, 1, 4294967311ull)
+				or ! test15_type<uint64_t>(words, nbits, 7, 0x123456789abcdefull) ) {
+				cout << "test15 fail: nbits=" << nbits << " density=" << density << endl;
+				return false;
+			}
+		}
+	}
+	// And the functions which now use it
+	auto plist = prime_list(1000000u);
+	prime_sieve_list<unsigned int> pl(1000);
+	std::vector<unsigned int> got(pl.primes);
+	pl.primes_range_pushback(1001, 1000000, 4096, got);
+	if ( got != plist ) {
+		cout << "test15 fail: primes_range_pushback" << endl;
+		return false;
+	}
+	sieve_stripe<unsigned int> ss(1000000);
+	ss.compute_section(0, 1000000);
+	if ( ss.prime_list() != plist ) {
+		cout << "test15 fail: sieve_stripe<T>::prime_list" << endl;
+		return false;
+	}
+	// The portable path over a sieve longer than its buffer
+	std::vector<unsigned int> portable(1, 2);
+	extract_bits_pushback_portable(ss.sieve, 3u, 2u, portable);
+	if ( portable != plist ) {
+		cout << "test15 fail: extract_bits_pushback_portable" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test16()
+{
+	auto plist = prime_list(2000000u);
+	std::size_t count = 0;
+	for (unsigned int x = 0; x <= 2000000; ++x) {
+		if ( count < plist.size() and plist[count] == x ) { ++count; }
+		if ( prime_count_upper_bound(x) < count ) {
+			cout << "test16 fail: bound for x=" << x << endl;
+			return false;
+		}
+	}
+	uint64_t state = 777;
+	for (int i = 0; i < 10000; ++i) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		unsigned int lo = (state >> 33) % 2000000;
+		unsigned int hi = lo + (state >> 13) % ( i%2 == 0 ? 1000 : 100000 );
+		if ( hi > 2000000 ) { hi = 2000000; }
+		auto first = std::lower_bound(plist.begin(), plist.end(), lo);
+		auto last = std::upper_bound(plist.begin(), plist.end(), hi);
+		if ( prime_count_upper_bound(lo, hi) < static_cast<std::size_t>(last - first) ) {
+			cout << "test16 fail: bound for [" << lo << "," << hi << "]" << endl;
+			return false;
+		}
+	}
+	// If the list had ever grown, its capacity would be more than was reserved
+	for (unsigned int len : {5u, 97u, 1000u, 65536u, 999999u}) {
+		std::size_t bound = prime_count_upper_bound(len);
+		sieve_stripe<unsigned int> ss(len);
+		ss.compute_section(0, len);
+		wheel_sieve<unsigned int> ws(len);
+		ws.compute_section(0, len);
+		if ( prime_list(len).capacity() != bound or prime_list1(len).capacity() != bound
+			or prime_list2(len).capacity() != bound or prime_list2(len, 4096u).capacity() != bound
+			or prime_list3(len).capacity() != bound or ss.prime_list().capacity() != bound
+			or ws.prime_list().capacity() != bound
+			or prime_list_bucket(100u, len).capacity() != prime_count_upper_bound(100u, len) ) {
+			cout << "test16 fail: reallocation for len=" << len << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool test17()
+{
+	for (unsigned int len=0; len<=3000; ++len) {
+		auto plist = prime_list(len < 3 ? 3 : len);
+		while ( not plist.empty() and plist.back() > len ) { plist.pop_back(); }
+		atkin_sieve<unsigned int> as(len);
+		for (unsigned int n=0; n<=len; n+=95) {
+			as.compute_section(n, n+94);
+		}
+		if ( as.prime_list() != plist ) {
+			cout << "test17 fail: len=" << len << endl;
+			return false;
+		}
+		for (unsigned int p=0; p<=len+2; ++p) {
+			if ( as.is_prime(p) != std::binary_search(plist.begin(), plist.end(), p) ) {
+				cout << "test17 fail: is_prime(" << p << "), len=" << len << endl;
+				return false;
+			}
+		}
+	}
+	for (unsigned int len=100; len<=40000; len+=997) {
+		auto plist = prime_list(len);
+		for (unsigned int threads=1; threads<=5; threads+=2) {
+			atkin_sieve<unsigned int> as(len);
+			parallel_compute(as, len, threads, 1024u);
+			if ( as.prime_list() != plist ) {
+				cout << "test17 fail: parallel, len=" << len << " threads=" << threads << endl;
+				return false;
+			}
+		}
+		for (unsigned int stripe : {1024u, 5000u, 65536u}) {
+			if ( engine_prime_list<atkin_sieve<unsigned int>>(len, stripe) != plist
+				or engine_prime_list<sieve_stripe<unsigned int>>(len, stripe) != plist
+				or engine_prime_list<wheel_sieve<unsigned int>>(len, stripe) != plist ) {
+				cout << "test17 fail: engine_prime_list, len=" << len << " stripe=" << stripe << endl;
+				return false;
+			}
+		}
+	}
+	// Near the top of the range of T, where 4x^2 + y^2 overflows 32 bits
+	unsigned int top = 4294967295u;
+	atkin_sieve<unsigned int> as(top);
+	as.compute_section(top - 100000, top);
+	prime_sieve_list<uint64_t> pl(65537);
+	auto expected = pl.primes_range(top - 100000, top);
+	for (unsigned int n = top - 100000; ; ++n) {
+		if ( as.is_prime(n) != std::binary_search(expected.begin(), expected.end(), uint64_t(n)) ) {
+			cout << "test17 fail: near 2^32, n=" << n << endl;
+			return false;
+		}
+		if ( n == top ) { break; }
+	}
+	return true;
+}
+
+/** Factor n by trial division, and check the table entry at index i */
+template <typename T>
+bool test18_check(const multiplicative_table<T> &table, std::size_t i)
+{
+	T n = table.start + static_cast<T>(i);
+	T spf = 0, phi = 1;
+	int mu = 1;
+	unsigned int d = 1;
+	if ( n == 0 ) { phi = 0; mu = 0; d = 0; }
+	if ( n == 1 ) { spf = 1; }
+	T m = n;
+	for (T p = 2; m > 1 and p <= m / p; ++p) {
+		if ( m%p != 0 ) { continue; }
+		if ( spf == 0 ) { spf = p; }
+		unsigned int k = 0;
+		while ( m%p == 0 ) { m /= p; ++k; }
+		phi *= p - 1;
+		for (unsigned int j = 1; j < k; ++j) { phi *= p; }
+		mu = ( k == 1 ) ? -mu : 0;
+		d *= k + 1;
+	}
+	if ( m > 1 ) {
+		if ( spf == 0 ) { spf = m; }
+		phi *= m - 1;
+		mu = -mu;
+		d *= 2;
+	}
+	return table.spf[i] == spf and table.phi[i] == phi and table.mu[i] == mu and table.divisors[i] == d;
+}
+
+bool test18()
+{
+	for (unsigned int stripe : {1u, 7u, 100u, 4096u, 0u}) {
+		auto table = multiplicative_window(0u, 20000u, stripe);
+		if ( table.size() != 20001 ) {
+			cout << "test18 fail: size, stripe=" << stripe << endl;
+			return false;
+		}
+		for (std::size_t i = 0; i < table.size(); ++i) {
+			if ( ! test18_check(table, i) ) {
+				cout << "test18 fail: n=" << i << " stripe=" << stripe << endl;
+				return false;
+			}
+		}
+	}
+	multiplicative_sieve<unsigned int> ms(10000000);
+	for (unsigned int start : {1u, 2u, 9999u, 123456u, 9990000u}) {
+		auto table = ms.compute(start, start + 9999, 1000u);
+		for (std::size_t i = 0; i < table.size(); ++i) {
+			if ( ! test18_check(table, i) ) {
+				cout << "test18 fail: n=" << start+i << endl;
+				return false;
+			}
+		}
+	}
+	// Up to the top of the range, and with 64-bit integers
+	auto table = multiplicative_window(4294967295u - 2000, 4294967295u, 512u);
+	for (std::size_t i = 0; i < table.size(); ++i) {
+		if ( ! test18_check(table, i) ) {
+			cout << "test18 fail: n=" << table.start+i << endl;
+			return false;
+		}
+	}
+	auto table64 = multiplicative_window<uint64_t>(1000000000000ull, 1000000000000ull + 300);
+	for (std::size_t i = 0; i < table64.size(); ++i) {
+		if ( ! test18_check(table64, i) ) {
+			cout << "test18 fail: n=" << table64.start+i << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool test19()
+{
+	auto plist = prime_list(70000u);
+	if ( small_primes.size() != small_prime_count
+		or ! std::equal(small_primes.begin(), small_primes.end(), plist.begin())
+		or plist[small_prime_count] < small_prime_limit ) {
+		cout << "test19 fail: small_primes" << endl;
+		return false;
+	}
+	for (unsigned int len=3; len<=70000; len += ( len < 1000 ? 1 : 37 )) {
+		auto expected = prime_list(len);
+		if ( small_prime_list(len) != expected or small_prime_list<uint64_t>(len).size() != expected.size() ) {
+			cout << "test19 fail: len=" << len << endl;
+			return false;
+		}
+	}
+	if ( ! small_prime_list(1u).empty() or small_prime_list(2).size() != 1 or ! small_prime_list(-5).empty() ) {
+		cout << "test19 fail: len < 3" << endl;
+		return false;
+	}
+	// The pre-sieve patterns
+	std::vector<uint64_t> words(5000);
+	get_odd_presieve().fill(words.data(), words.size(), 0);
+	for (uint64_t i = 0; i < 64*words.size(); ++i) {
+		uint64_t n = 2*i+1;
+		bool expect = n%3 != 0 and n%5 != 0 and n%7 != 0 and n%11 != 0 and n%13 != 0 and n%17 != 0;
+		if ( ( (words[i/64] >> (i%64)) & 1 ) != expect ) {
+			cout << "test19 fail: odd_presieve, n=" << n << endl;
+			return false;
+		}
+	}
+	for (uint64_t k = 0; k < 40000; ++k) {
+		for (unsigned int i = 0; i < 8; ++i) {
+			uint64_t n = 30*k + wheel30_residues[i];
+			bool expect = n%7 != 0 and n%11 != 0 and n%13 != 0 and n%17 != 0;
+			if ( ( (get_wheel_presieve().byte(k) >> i) & 1 ) != expect ) {
+				cout << "test19 fail: wheel_presieve, n=" << n << endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool test20()
+{
+	auto plist = prime_list(3000000u);
+	auto expect = [&plist](unsigned int start, unsigned int end) {
+		auto first = std::lower_bound(plist.begin(), plist.end(), start);
+		auto last = std::upper_bound(plist.begin(), plist.end(), end);
+		return std::vector<unsigned int>(first, last);
+	};
+	for (unsigned int segment : {64u, 1000u, 0u}) {
+		growable_sieve<unsigned int> gs(0, segment);
+		uint64_t state = segment;
+		for (unsigned int len = 10; len <= 3000000; len += len/7 + 1) {
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			unsigned int start = (state >> 33) % (len+1);
+			if ( gs.primes_range(start, len) != expect(start, len) or gs.limit() < len ) {
+				cout << "test20 fail: [" << start << "," << len << "] segment=" << segment << endl;
+				return false;
+			}
+			unsigned int p = (state >> 11) % (len+1);
+			if ( gs.is_prime(p) != std::binary_search(plist.begin(), plist.end(), p) ) {
+				cout << "test20 fail: is_prime(" << p << ") segment=" << segment << endl;
+				return false;
+			}
+		}
+		// Every word was sieved exactly once
+		if ( gs.sieved_words() != (gs.limit() + 1) / 128 ) {
+			cout << "test20 fail: re-sieved, segment=" << segment << endl;
+			return false;
+		}
+	}
+	// A big jump, past the compile time table of sieving primes
+	growable_sieve<uint64_t> big(1000);
+	uint64_t start = 4294967296ull - 1000;
+	auto got = big.primes_range(start, start + 100000);
+	prime_sieve_list<uint64_t> pl(integer_sqrt(start + 100000) + 1);
+	if ( got != pl.primes_range(start, start + 100000) or ! big.is_prime(4294967311ull) or big.is_prime(4294967297ull) ) {
+		cout << "test20 fail: past 2^32" << endl;
+		return false;
+	}
+	// Up to the top of the range of T
+	growable_sieve<unsigned short> top(0, 4096);
+	auto last = top.primes_range(65000, 65535);
+	if ( last.size() != expect(65000, 65535).size() or ! std::equal(last.begin(), last.end(), expect(65000, 65535).begin())
+		or top.limit() != 65535 ) {
+		cout << "test20 fail: top of range" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test21()
+{
+	auto plist = prime_list(2000000u);
+	std::vector<bool> isp(2000001, false);
+	for (auto p : plist) { isp[p] = true; }
+	for (unsigned int len : {3u, 4u, 1000u, 1999999u, 2000000u}) {
+		for (unsigned int segment : {128u, 1000u, 0u}) {
+			lazy_sieve<unsigned int> ls(len, segment);
+			// Threads ask about scattered numbers, so they race to compute the same segments
+			const unsigned int threads = 4;
+			std::vector<int> ok(threads, 1);
+			auto work = [&ls,&isp,&ok,len](unsigned int me) {
+				uint64_t state = me + 1;
+				for (int i = 0; i < 20000; ++i) {
+					state = state * 6364136223846793005ull + 1442695040888963407ull;
+					unsigned int n = (state >> 33) % (len + 3);
+					bool expect = n <= len and isp[n];
+					if ( ls.is_prime(n) != expect ) { ok[me] = 0; }
+				}
+			};
+			std::vector<std::thread> workers;
+			for (unsigned int i = 0; i < threads; ++i) { workers.push_back(std::thread(work, i)); }
+			for (auto &w : workers) { w.join(); }
+			for (auto v : ok) {
+				if ( ! v ) {
+					cout << "test21 fail: is_prime, len=" << len << " segment=" << segment << endl;
+					return false;
+				}
+			}
+			if ( ls.segments_computed() > ls.segments() ) {
+				cout << "test21 fail: segments computed more than once, len=" << len << endl;
+				return false;
+			}
+			for (unsigned int start : {0u, 2u, 3u, 999u, 77777u}) {
+				unsigned int end = start + 123456;
+				auto first = std::lower_bound(plist.begin(), plist.end(), start);
+				auto last = std::upper_bound(plist.begin(), plist.end(), std::min(end, len));
+				std::vector<unsigned int> expect;
+				if ( first < last ) { expect.assign(first, last); }
+				if ( ls.primes_range(start, end) != expect ) {
+					cout << "test21 fail: primes_range, len=" << len << " start=" << start << endl;
+					return false;
+				}
+			}
+		}
+	}
+	// Only the segments asked about are computed
+	lazy_sieve<uint64_t> big(1000000000000ull);
+	if ( ! big.is_prime(999999999989ull) or big.is_prime(999999999991ull) or big.segments_computed() != 1 ) {
+		cout << "test21 fail: near 10^12" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test22()
+{
+	for (unsigned int len : {0u, 1u, 2u, 3u, 100u, 1000u, 65536u, 2000000u}) {
+		auto plist = small_prime_list(len);
+		for (unsigned int segment : {128u, 1000u, 0u}) {
+			auto cl = compressed_prime_list_sieve(len, segment);
+			if ( cl.size() != plist.size() or cl.to_vector() != plist ) {
+				cout << "test22 fail: compressed_prime_list_sieve, len=" << len << " segment=" << segment << endl;
+				return false;
+			}
+		}
+		compressed_prime_list<unsigned int> cl(plist);
+		for (std::size_t i = 0; i < plist.size(); i += 1 + i/50) {
+			if ( cl[i] != plist[i] ) {
+				cout << "test22 fail: operator[], len=" << len << " i=" << i << endl;
+				return false;
+			}
+			std::size_t n = std::min<std::size_t>(300, plist.size() - i);
+			std::vector<unsigned int> out(n);
+			cl.decode(i, n, out.data());
+			if ( ! std::equal(out.begin(), out.end(), plist.begin() + i) ) {
+				cout << "test22 fail: decode, len=" << len << " i=" << i << endl;
+				return false;
+			}
+		}
+	}
+	// Gaps needing the escape, and a list without 2, in 64 and 16 bits
+	std::vector<uint64_t> wide;
+	uint64_t v = 304599508537ull;
+	for (int i = 0; i < 1000; ++i) {
+		wide.push_back(v);
+		v += ( i%7 == 0 ) ? 514 : ( i%5 == 0 ) ? 131070 : 2*(i%200) + 2;
+	}
+	compressed_prime_list<uint64_t> cw(wide);
+	for (std::size_t i = 0; i < wide.size(); ++i) {
+		if ( cw[i] != wide[i] ) {
+			cout << "test22 fail: escaped gaps, i=" << i << endl;
+			return false;
+		}
+	}
+	if ( cw.to_vector() != wide ) {
+		cout << "test22 fail: escaped gaps, decode" << endl;
+		return false;
+	}
+	if ( compressed_prime_list_sieve<uint64_t>(1000000).to_vector() != prime_list<uint64_t>(1000000)
+		or compressed_prime_list_sieve<unsigned short>(65535).to_vector() != small_prime_list<unsigned short>(65535) ) {
+		cout << "test22 fail: other types" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test23()
+{
+	for (unsigned int len : {0u, 1u, 2u, 3u, 4u, 100u, 1000u, 65536u, 2000000u, 2000001u}) {
+		auto expect = small_prime_list(len);
+		for (unsigned int threads : {1u, 2u, 3u, 8u}) {
+			for (unsigned int segment : {128u, 1000u, 0u}) {
+				if ( parallel_prime_list(len, threads, segment) != expect ) {
+					cout << "test23 fail: len=" << len << " threads=" << threads << " segment=" << segment << endl;
+					return false;
+				}
+			}
+		}
+	}
+	if ( parallel_prime_list<uint64_t>(10000000, 4) != prime_list<uint64_t>(10000000)
+		or parallel_prime_list<unsigned short>(65535, 4) != small_prime_list<unsigned short>(65535) ) {
+		cout << "test23 fail: other types" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test24()
+{
+	auto plist = prime_list(2000000u);
+	std::vector<bool> isp(2000001, false);
+	for (auto p : plist) { isp[p] = true; }
+	// Every x up to 5000, then scattered x up to 2*10^6
+	uint128_t sum = 0, powers = 0;
+	for (unsigned int x = 0; x <= 2000000; ++x) {
+		if ( isp[x] ) {
+			sum += x;
+			for (uint64_t pk = x; pk <= 2000000; pk *= x) { powers += pk; }
+		}
+		if ( x > 5000 and x % 99991 != 0 and x != 2000000 ) { continue; }
+		uint64_t pp = 0; // Sum of the prime powers up to x
+		for (auto p : plist) {
+			if ( p > x ) { break; }
+			for (uint64_t pk = p; pk <= x; pk *= p) { pp += pk; }
+		}
+		for (unsigned int threads : {1u, 3u}) {
+			if ( prime_sum(x, threads) != sum or prime_power_sum(x, threads) != pp ) {
+				cout << "test24 fail: x=" << x << " threads=" << threads << endl;
+				return false;
+			}
+		}
+	}
+	if ( sum != 142913828922ull or powers != prime_power_sum(2000000u) ) {
+		cout << "test24 fail: sum up to 2*10^6" << endl;
+		return false;
+	}
+	// Known values, which need more than 64 bits
+	if ( uint128_to_string(prime_sum<uint64_t>(10000000000ull, 2)) != "2220822432581729238"
+		or uint128_to_string(prime_sum<uint64_t>(100000000000ull, 3)) != "201467077743744681014" ) {
+		cout << "test24 fail: 10^10 and 10^11" << endl;
+		return false;
+	}
+	return true;
+}
+
+/** gap_statistics worked out from a list of the primes in the range */
+template <typename T>
+prime_gap_statistics<T> test25_expect(const std::vector<T> &primes, T end, const std::vector<std::vector<T>> &patterns)
+{
+	prime_gap_statistics<T> stats(patterns.size());
+	for (auto p : primes) { stats.add_prime(p); }
+	for (std::size_t t = 0; t < patterns.size(); ++t) {
+		for (auto p : primes) {
+			if ( p == 2 ) { continue; }
+			bool all = true;
+			for (auto o : patterns[t]) {
+				all = all and p + o <= end and std::binary_search(primes.begin(), primes.end(), p + o);
+			}
+			if ( all ) { ++stats.tuple_counts[t]; }
+		}
+	}
+	return stats;
+}
+
+template <typename T>
+bool test25_same(const prime_gap_statistics<T> &a, const prime_gap_statistics<T> &b)
+{
+	std::size_t n = std::max(a.gap_counts.size(), b.gap_counts.size());
+	for (std::size_t g = 0; g < n; ++g) {
+		if ( (g < a.gap_counts.size() ? a.gap_counts[g] : 0) != (g < b.gap_counts.size() ? b.gap_counts[g] : 0) ) { return false; }
+	}
+	return a.count == b.count and ( a.count == 0 or (a.first == b.first and a.last == b.last) )
+		and a.record_gaps == b.record_gaps and a.tuple_counts == b.tuple_counts;
+}
+
+bool test25()
+{
+	auto plist = prime_list(3000000u);
+	std::vector<std::vector<unsigned int>> patterns = prime_tuple_patterns<unsigned int>();
+	patterns.push_back({0, 2, 4});
+	patterns.push_back({0, 130, 260});
+	for (auto range : std::vector<std::pair<unsigned int, unsigned int>>{ {0, 0}, {0, 2}, {2, 3}, {3, 3},
+		{0, 100}, {5, 7}, {1000, 1000000}, {0, 3000000}, {999999, 2999999}, {2000000, 2000100} }) {
+		unsigned int start = range.first, end = range.second;
+		std::vector<unsigned int> primes(std::lower_bound(plist.begin(), plist.end(), start),
+			std::upper_bound(plist.begin(), plist.end(), end));
+		auto expect = test25_expect(primes, end, patterns);
+		for (unsigned int threads : {1u, 3u}) {
+			for (unsigned int segment : {128u, 1000u, 0u}) {
+				if ( ! test25_same(gap_statistics(start, end, patterns, threads, segment), expect) ) {
+					cout << "test25 fail: start=" << start << " end=" << end << " threads=" << threads
+						<< " segment=" << segment << endl;
+					return false;
+				}
+			}
+		}
+	}
+	auto all = gap_statistics(0u, 3000000u);
+	if ( all.max_gap() != 148 or all.record_gaps.back().first != 2010733 or all.tuple_counts[0] != 20932 ) {
+		cout << "test25 fail: known values up to 3*10^6" << endl;
+		return false;
+	}
+	// Above 2^32, and the top of the range of T
+	lazy_sieve<uint64_t> ls(5000100000ull);
+	auto big = ls.primes_range(5000000000ull, 5000100000ull);
+	auto patterns64 = prime_tuple_patterns<uint64_t>();
+	if ( ! test25_same(gap_statistics<uint64_t>(5000000000ull, 5000100000ull, patterns64, 2, 1000), test25_expect(big, uint64_t(5000100000ull), patterns64)) ) {
+		cout << "test25 fail: above 2^32" << endl;
+		return false;
+	}
+	auto top = small_prime_list<unsigned short>(65535);
+	auto patterns16 = prime_tuple_patterns<unsigned short>();
+	if ( ! test25_same(gap_statistics<unsigned short>(0, 65535, patterns16, 2, 1000), test25_expect(top, (unsigned short)65535, patterns16)) ) {
+		cout << "test25 fail: unsigned short" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test26()
+{
+	auto plist = prime_list(1000000u);
+	auto gcd = [](unsigned int x, unsigned int y) {
+		while ( y != 0 ) { unsigned int t = x % y; x = y; y = t; }
+		return x;
+	};
+	for (unsigned int q : {1u, 2u, 3u, 4u, 6u, 10u, 30u, 97u, 1000u, 1024u, 1000003u}) {
+		unsigned int phi = 0;
+		for (unsigned int r = 0; r < q; ++r) { phi += ( gcd(q, r) == 1 ) ? 1 : 0; }
+		for (unsigned int a : {0u, 1u, 2u, 3u, 5u, 7u, 96u, 513u, 999u, 1000001u}) {
+			if ( a >= q and a != 1000001u ) { continue; }
+			bool coprime = gcd(q, a % q) == 1;
+			for (unsigned int segment : {64u, 1000u, 0u}) {
+				progression_sieve<unsigned int> ps(q, a, 1000000u, segment);
+				for (auto range : std::vector<std::pair<unsigned int, unsigned int>>{ {0, 1000000}, {0, 1},
+					{2, 2}, {17, 17}, {500, 77777}, {999000, 2000000} }) {
+					std::vector<unsigned int> expect;
+					for (auto p : plist) {
+						if ( p >= range.first and p <= range.second and p % q == a % q ) { expect.push_back(p); }
+					}
+					auto primes = ps.primes_range(range.first, range.second);
+					if ( primes != expect or ps.count(range.first, range.second) != expect.size() ) {
+						cout << "test26 fail: q=" << q << " a=" << a << " segment=" << segment
+							<< " range=" << range.first << "," << range.second << endl;
+						return false;
+					}
+					// If the list had ever grown, its capacity would be more than was reserved
+					if ( coprime and q <= 1000000u and ! expect.empty() and primes.capacity()
+						!= prime_count_upper_bound(range.first, std::min(range.second, 1000000u)) / phi + 16 ) {
+						cout << "test26 fail: list grew, q=" << q << " a=" << a
+							<< " range=" << range.first << "," << range.second << endl;
+						return false;
+					}
+				}
+			}
+		}
+	}
+	// Above 2^32
+	lazy_sieve<uint64_t> ls(5001000000ull);
+	std::vector<uint64_t> expect;
+	for (auto p : ls.primes_range(5000000000ull, 5001000000ull)) {
+		if ( p % 1024 == 1 ) { expect.push_back(p); }
+	}
+	progression_sieve<uint64_t> big(1024, 1, 5001000000ull);
+	if ( big.primes_range(5000000000ull, 5001000000ull) != expect ) {
+		cout << "test26 fail: above 2^32" << endl;
+		return false;
+	}
+	// A modulus above 2^32, so that the list is extracted with a step which doesn't fit in 32 bits
+	const uint64_t bigq = 4294967311ull, biglen = 2000000000000ull;
+	expect.clear();
+	for (uint64_t n = bigq + 1; n <= biglen; n += bigq) {
+		bool prime = ( n % 2 != 0 );
+		for (uint64_t d = 3; prime and d*d <= n; d += 2) { prime = ( n % d != 0 ); }
+		if ( prime ) { expect.push_back(n); }
+	}
+	progression_sieve<uint64_t> wide(bigq, 1, biglen);
+	if ( wide.primes_range(0, biglen) != expect ) {
+		cout << "test26 fail: q=" << bigq << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test27()
+{
+	auto plist = prime_list(30000000u);
+	for (uint64_t k = 0; k <= plist.size(); k += ( k < 20000 ) ? 1 : 997) {
+		unsigned int expect = ( k == 0 ) ? 0 : plist[k-1];
+		if ( nth_prime<unsigned int>(k) != expect ) {
+			cout << "test27 fail: k=" << k << endl;
+			return false;
+		}
+	}
+	// The largest primes of each type, and known values
+	if ( nth_prime<unsigned short>(6542) != 65521 or nth_prime<unsigned short>(6543) != 0
+		or nth_prime<unsigned int>(203280221) != 4294967291u or nth_prime<unsigned int>(203280222) != 0
+		or nth_prime<uint64_t>(203280222) != 4294967311ull or nth_prime<uint64_t>(1000000000, 2) != 22801763489ull ) {
+		cout << "test27 fail: known values" << endl;
+		return false;
+	}
+	// Past pi(2^32-1), where li^{-1}(k) is above 2^32 but Rosser's lower bound isn't yet
+	for (uint64_t k : {203280223ull, 203290000ull, 203300000ull, 203500000ull, 203600000ull, 203700000ull}) {
+		if ( nth_prime<unsigned int>(k) != 0 ) {
+			cout << "test27 fail: k=" << k << " should not fit in 32 bits" << endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+/** Instrumented sieves give the same answers, and record one stripe for each piece of
+  * work, with the right number of integers */
+bool test28()
+{
+	const unsigned int n = 3000000, size = 40000;
+	perf_instrumentation(true);
+	sieve_stripe<unsigned int> ss(n);
+	auto r = parallel_compute(ss, n, 3, 4096u);
+	auto primes = prime_list3(n, size);
+	perf_instrumentation(false);
+	perf_report report = perf_collect();
+	if ( ss.sieve != sieve<unsigned int>(n).get_sieve() or primes != prime_list(n) ) {
+		cout << "test28 fail: instrumented sieves differ" << endl;
+		return false;
+	}
+	uint64_t sections = 0, section_integers = 0, stripes = 0, stripe_integers = 0;
+	for (const auto &s : report.stripes) {
+		if ( s.thread >= 3 ) {
+			cout << "test28 fail: thread " << s.thread << endl;
+			return false;
+		}
+		if ( s.site == perf_compute_section ) { ++sections; section_integers += s.integers; }
+		else { ++stripes; stripe_integers += s.integers; }
+	}
+	// Every segment but perhaps the last is recorded; each covers an odd start to its end
+	unsigned int segments = 0;
+	for (auto c : r.segments) { segments += c; }
+	if ( sections + 1 < segments or sections > segments
+		or section_integers > n - 2 or section_integers + 2*sections < n - 2 ) {
+		cout << "test28 fail: " << sections << " sections of " << segments << ", "
+			<< section_integers << " integers" << endl;
+		return false;
+	}
+	// prime_list3 sieves from the odd number above sqrt_len+1, for sqrt_len = ceil(sqrt(n))
+	unsigned int start = integer_sqrt(n);
+	if ( start * start < n ) { ++start; }
+	start += 1;
+	start += 1 - start%2;
+	if ( stripe_integers != n - start + 1 or stripes != (n - start + size) / size ) {
+		cout << "test28 fail: " << stripes << " stripes, " << stripe_integers << " integers" << endl;
+		return false;
+	}
+	if ( (report.valid & 3) == 3 ) {
+		perf_sample total = report.site_total(perf_partial_sieve);
+		if ( total.cycles == 0 or total.instructions == 0 ) {
+			cout << "test28 fail: no cycles counted" << endl;
+			return false;
+		}
+	}
+	// Nothing is recorded once switched off
+	prime_list3(n, size);
+	if ( perf_collect().stripes.size() != report.stripes.size() ) {
+		cout << "test28 fail: recorded while switched off" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test29()
+{
+	const unsigned int n = 2000000;
+	auto plist = prime_list(n);
+	auto expect = [&plist](unsigned int start, unsigned int end) {
+		auto first = std::lower_bound(plist.begin(), plist.end(), start);
+		auto last = std::upper_bound(plist.begin(), plist.end(), end);
+		return ( first < last ) ? std::vector<unsigned int>(first, last) : std::vector<unsigned int>();
+	};
+	for (unsigned int len : {2u, 10u, 1000u, n}) {
+		for (unsigned int gap : {1u, 0u, 100000u}) {
+			prime_batch_sieve<unsigned int> bs(len, gap, 1024);
+			// Threads each ask batches of short, overlapping and empty ranges, sharing one object
+			const unsigned int threads = 3;
+			std::vector<int> ok(threads, 1);
+			auto work = [&bs,&expect,&ok,len](unsigned int me) {
+				uint64_t state = me + 1;
+				prime_batch_result<unsigned int> result;
+				for (int batch = 0; batch < 20; ++batch) {
+					std::vector<std::pair<unsigned int, unsigned int>> queries;
+					for (int i = 0; i < 50; ++i) {
+						state = state * 6364136223846793005ull + 1442695040888963407ull;
+						unsigned int start = (state >> 33) % (len + 3);
+						unsigned int width = ( i%5 == 0 ) ? (state >> 13) % 5000 : (state >> 13) % 200;
+						queries.push_back(std::make_pair(start, ( i%17 == 0 ) ? start - 1 : start + width));
+					}
+					queries.push_back(std::make_pair(0u, 2u));
+					queries.push_back(queries[3]);
+					bs.query(queries, result);
+					if ( result.size() != queries.size() ) { ok[me] = 0; }
+					for (std::size_t i = 0; i < queries.size() and ok[me]; ++i) {
+						auto e = ( queries[i].second < queries[i].first ) ? std::vector<unsigned int>()
+							: expect(queries[i].first, std::min(queries[i].second, len));
+						if ( result.query(i) != e or result.count(i) != e.size() ) { ok[me] = 0; }
+					}
+				}
+			};
+			std::vector<std::thread> workers;
+			for (unsigned int i = 0; i < threads; ++i) { workers.push_back(std::thread(work, i)); }
+			for (auto &w : workers) { w.join(); }
+			for (auto v : ok) {
+				if ( ! v ) {
+					cout << "test29 fail: len=" << len << " gap=" << gap << endl;
+					return false;
+				}
+			}
+		}
+	}
+	// Large values, and the one-off function
+	std::vector<std::pair<uint64_t, uint64_t>> queries = { {10000000000ull, 10000001000ull},
+		{4294967200ull, 4294967400ull}, {10000000500ull, 10000002000ull}, {7, 7} };
+	auto result = prime_batch_query(queries);
+	prime_sieve_list<uint64_t> pl(100001);
+	for (std::size_t i = 0; i < 3; ++i) {
+		if ( result.query(i) != pl.primes_range(queries[i].first, queries[i].second) ) {
+			cout << "test29 fail: large query " << i << endl;
+			return false;
+		}
+	}
+	if ( result.query(3) != std::vector<uint64_t>{7} ) {
+		cout << "test29 fail: query [7, 7]" << endl;
+		return false;
+	}
+	return true;
+}
+
+bool test30()
+{
+	auto plist = prime_list(2000000u);
+	for (uint64_t start : {0u, 1u, 2u, 3u, 999u, 1000000u}) {
+		for (uint64_t end : {0u, 2u, 3u, 1000u, 1999999u, 2000000u}) {
+			for (uint64_t segment : {128u, 1000u, 0u}) {
+				auto first = std::lower_bound(plist.begin(), plist.end(), start);
+				auto last = std::upper_bound(plist.begin(), plist.end(), end);
+				std::vector<uint64_t> expect;
+				if ( first < last ) { expect.assign(first, last); }
+				auto list = prime_list_dispatch(start, end, segment);
+				if ( list.to_vector() != expect or packed_prime_list<uint64_t>(start, end, segment) != expect ) {
+					cout << "test30 fail: start=" << start << " end=" << end << " segment=" << segment << endl;
+					return false;
+				}
+				for (std::size_t i = 0; i < expect.size(); i += 97) {
+					if ( list[i] != expect[i] ) {
+						cout << "test30 fail: operator[], start=" << start << " end=" << end << endl;
+						return false;
+					}
+				}
+			}
+		}
+	}
+	// Across 2^32, where the segments switch from 32-bit to 64-bit, and well past it
+	prime_sieve_list<uint64_t> pl(300000);
+	for (uint64_t start : {4294967296ull - 1000000, 4294967296ull - 1, 90000000000ull}) {
+		for (uint64_t segment : {1024u, 0u}) {
+			auto expect = pl.primes_range(start, start + 2000000);
+			if ( prime_list_dispatch(start, start + 2000000, segment).to_vector() != expect
+				or packed_prime_list<uint64_t>(start, start + 2000000, segment) != expect ) {
+				cout << "test30 fail: start=" << start << " segment=" << segment << endl;
+				return false;
+			}
+		}
+	}
+	// Blocks: values far enough apart that each needs a new base
+	std::vector<uint64_t> values = { 2, 3, 4294967295ull, 4294967298ull, 4294967299ull, 20000000000ull,
+		20000000001ull, 18446744073709551557ull };
+	offset_prime_list ol;
+	for (auto v : values) { ol.push_back(v); }
+	if ( ol.to_vector() != values or ol.num_blocks() != 4 ) {
+		cout << "test30 fail: blocks" << endl;
+		return false;
+	}
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		if ( ol[i] != values[i] ) {
+			cout << "test30 fail: blocks, operator[]" << endl;
+			return false;
+		}
+	}
+	return true;
 }
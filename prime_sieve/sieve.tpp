@@ -12,12 +12,73 @@
 
 #include <vector>
 #include <cmath>
+#include <cstddef>
+#include <algorithm>
+#include <initializer_list>
+
+#include "cache_info.h"
+#include "bit_extract.tpp"
+#include "small_primes.tpp"
+#include "perf_counters.h"
 
 #include <iostream>
 using std::cout;
 using std::endl;
 
 
+/** Largest r with r*r <= n.  For 64-bit T, sqrt() on a double can be out by one. */
+template <typename T>
+T integer_sqrt(const T n)
+{
+	T r = sqrt(static_cast<double>(n));
+	while ( r > 0 and r > n / r ) { --r; }
+	while ( r+1 <= n / (r+1) ) { ++r; }
+	return r;
+}
+
+/** An upper bound for pi(x), the number of primes <= x, used to reserve the whole list
+  * of primes up front.  Dusart's bound pi(x) < x/ln x * (1 + 1.2762/ln x) holds for all
+  * x > 1, and overestimates by about 5% at 10^9; we add a little for rounding error.
+  */
+template <typename T>
+std::size_t prime_count_upper_bound(const T x)
+{
+	if ( x < 2 ) { return 0; }
+	if ( x < 100 ) { return static_cast<std::size_t>(x/2 + 1); }
+	double lx = std::log(static_cast<double>(x));
+	return static_cast<std::size_t>( static_cast<double>(x) / lx * (1 + 1.2762 / lx) * (1 + 1e-9) ) + 2;
+}
+
+/** An upper bound for the number of primes in [lo, hi].  By the Brun-Titchmarsh theorem
+  * in the form of Montgomery and Vaughan, an interval of length y > 1 contains fewer than
+  * 2y/ln y primes; which is better than pi(hi) when hi is large and the interval short.
+  */
+template <typename T>
+std::size_t prime_count_upper_bound(const T lo, const T hi)
+{
+	if ( hi < lo or hi < 2 ) { return 0; }
+	std::size_t bound = prime_count_upper_bound(hi);
+	double y = static_cast<double>(hi - lo) + 1;
+	if ( y > 100 ) {
+		bound = std::min(bound, static_cast<std::size_t>( 2 * y / std::log(y) * (1 + 1e-9) ) + 2);
+	}
+	return bound;
+}
+
+/** A list which starts with `primes` and has room for all the primes up to `len`, so that
+  * appending the rest never reallocates. */
+template <typename T>
+std::vector<T> reserved_prime_list(const std::vector<T> &primes, const T len)
+{
+	std::vector<T> list;
+	list.reserve(std::max(primes.size(), prime_count_upper_bound(len)));
+	list.insert(list.end(), primes.begin(), primes.end());
+	return list;
+}
+
+
+
+
 // --------------------------------------------------------------------------
 // class sieve<T> code
 // --------------------------------------------------------------------------
@@ -84,6 +145,7 @@ std::vector<T> prime_list(const T len)
 {
 	sieve<T> s(len);
 	std::vector<T> primes;
+	primes.reserve(prime_count_upper_bound(len));
 	primes.push_back(2);
 	for (T p=3; p<=len; p+=2) {
 		if ( s.is_prime(p) ) { primes.push_back(p); }
@@ -91,6 +153,19 @@ std::vector<T> prime_list(const T len)
 	return primes;
 }
 
+/** As prime_list(len), but for len below 2^16 copies the primes from the table worked out
+  * at compile time (see small_primes.tpp) instead of sieving.  This is what the classes
+  * below use to find their small primes.
+  */
+template <typename T>
+std::vector<T> small_prime_list(const T len)
+{
+	if ( len < 2 ) { return std::vector<T>(); }
+	if ( static_cast<uint64_t>(len) >= small_prime_limit ) { return prime_list(len); }
+	auto end = std::upper_bound(small_primes.begin(), small_primes.end(), static_cast<uint32_t>(len));
+	return std::vector<T>(small_primes.begin(), end);
+}
+
 
 
 
@@ -110,7 +185,7 @@ std::vector<T> prime_list1(const T len)
 	// Get a list of primes of size sqrt(len)
 	T sqrt_len = sqrt(len);
 	if ( sqrt_len * sqrt_len < len ) { ++sqrt_len; }
-	auto primes = prime_list(sqrt_len);
+	auto primes = reserved_prime_list(prime_list(sqrt_len), len);
 	// Now re-create the rest of the sieve
 	std::vector<bool> sieve(len/2,true);
 	T start = sqrt_len + 1 - (sqrt_len%2); // If even add one
@@ -138,6 +213,36 @@ std::vector<T> prime_list1(const T len)
 }
 
 
+/** Set bits lo to hi of `sieve` from the odd_presieve pattern, bit i of the vector taking
+  * bit first + i of the pattern, so that the multiples of 3, 5, 7, 11, 13 and 17 (those
+  * primes included) are cleared.  Whole words are copied from the pattern, and the
+  * words at either end are ANDed with it, leaving the bits outside [lo, hi] alone.
+  * Returns false, having done nothing, if bool_vector_words() can't reach the words.
+  */
+inline bool presieve_bool_vector(std::vector<bool> &sieve, std::size_t lo, std::size_t hi, uint64_t first)
+{
+	uint64_t *words = bool_vector_words(sieve);
+	if ( words == nullptr ) { return false; }
+	if ( lo > hi ) { return true; }
+	const odd_presieve &pattern = get_odd_presieve();
+	auto and_word = [words,first,&pattern](std::size_t w, uint64_t mask) {
+		uint64_t bits;
+		pattern.fill(&bits, 1, first + 64*w);
+		words[w] &= bits | ~mask;
+	};
+	std::size_t wlo = lo/64, whi = hi/64;
+	uint64_t lomask = ~uint64_t(0) << (lo%64), himask = ~uint64_t(0) >> (63 - hi%64);
+	if ( wlo == whi ) {
+		and_word(wlo, lomask & himask);
+		return true;
+	}
+	if ( lo%64 != 0 ) { and_word(wlo++, lomask); }
+	if ( hi%64 != 63 ) { and_word(whi--, himask); }
+	if ( wlo <= whi ) { pattern.fill(words + wlo, whi - wlo + 1, first + 64*wlo); }
+	return true;
+}
+
+
 
 
 
@@ -155,8 +260,8 @@ public:
 	std::vector<T> primes;
 	std::vector<bool> partial_sieve(T start, T end)const;
 	std::vector<bool> partial_sieve(T start, T end, T stripe_size)const;
-	std::vector<T> sieve_to_list(T start, std::vector<bool> sieve)const;
-	void sieve_to_list_pushback(T start, std::vector<bool> sieve, std::vector<T> &l)const;
+	std::vector<T> sieve_to_list(T start, const std::vector<bool> &sieve)const;
+	void sieve_to_list_pushback(T start, const std::vector<bool> &sieve, std::vector<T> &l)const;
 	inline std::vector<T> primes_range(T start, T end)const
 		{ return sieve_to_list(start, partial_sieve(start,end)); }
 	void primes_range_pushback(T start, T end, T stripe_size, std::vector<T> &vec)const;
@@ -166,7 +271,7 @@ public:
 template <typename T>
 prime_sieve_list<T>::prime_sieve_list(const T len)
 {
-	primes = prime_list(len);
+	primes = small_prime_list(len);
 }
 
 /** Constructs a partial sieve.  Assumes start > len
@@ -178,8 +283,13 @@ std::vector<bool> prime_sieve_list<T>::partial_sieve(T start, T end)const
 {
 	start += 1 - (start%2); // Increase, if necessary, to make odd
 	if ( start > end ) { return std::vector<bool>(0); }
+	perf_stripe_scope perf(perf_partial_sieve, uint64_t(end) - start + 1);
 	std::vector<bool> sieve((end-start)/2+1,true);
-	for (auto it = primes.begin()+1; it != primes.end(); ++it) {
+	auto first = primes.begin()+1;
+	if ( primes.size() > 6 and presieve_bool_vector(sieve, 0, sieve.size()-1, start/2) ) {
+		first += 6; // 3, ..., 17 are done
+	}
+	for (auto it = first; it != primes.end(); ++it) {
 		auto p = *it;
 		T ps = start + p - 1;
 		ps = ps - (ps % p);
@@ -202,10 +312,15 @@ std::vector<bool> prime_sieve_list<T>::partial_sieve(T start, T end, T stripe_si
 	start += 1 - (start%2); // Increase, if necessary, to make odd
 	if ( start > end ) { return std::vector<bool>(0); }
 	std::vector<bool> sieve((end-start)/2+1,true);
+	auto first = primes.begin()+1;
+	if ( primes.size() > 6 and presieve_bool_vector(sieve, 0, sieve.size()-1, start/2) ) {
+		first += 6; // 3, ..., 17 are done
+	}
 	for (T stripe_start = start; stripe_start <= end; stripe_start += stripe_size) {
 		T stripe_end = stripe_start + stripe_size - 1;
 		if ( stripe_end > end ) { stripe_end = end; }
-		for (auto it = primes.begin()+1; it != primes.end(); ++it) {
+		perf_stripe_scope perf(perf_partial_sieve, uint64_t(stripe_end) - stripe_start + 1);
+		for (auto it = first; it != primes.end(); ++it) {
 			auto p = *it;
 			T ps = stripe_start + p - 1;
 			ps = ps - (ps % p);
@@ -221,7 +336,7 @@ std::vector<bool> prime_sieve_list<T>::partial_sieve(T start, T end, T stripe_si
 /** Use a sieve to make a list of primes.  If start is even it's increased to make it odd.
   */
 template <typename T>
-std::vector<T> prime_sieve_list<T>::sieve_to_list(T start, std::vector<bool> sieve)const
+std::vector<T> prime_sieve_list<T>::sieve_to_list(T start, const std::vector<bool> &sieve)const
 {
 	std::vector<T> prange;
 	sieve_to_list_pushback(start, sieve, prange);
@@ -229,18 +344,18 @@ std::vector<T> prime_sieve_list<T>::sieve_to_list(T start, std::vector<bool> sie
 }
 
 /** Same as sieve_to_list but uses passed vector.
+  * Reads the sieve a word at a time, see bit_extract.tpp.  When calling this repeatedly,
+  * reserve space first (e.g. with prime_count_upper_bound) to avoid reallocations.
   */
 template <typename T>
-void prime_sieve_list<T>::sieve_to_list_pushback(T start, std::vector<bool> sieve, std::vector<T> &vec)const
+void prime_sieve_list<T>::sieve_to_list_pushback(T start, const std::vector<bool> &sieve, std::vector<T> &vec)const
 {
 	start += 1 - (start%2); // Increase, if necessary, to make odd
-	T p = start;
-	for (auto it = sieve.begin(); it != sieve.end(); ++it, p+=2) {
-		if ( *it ) { vec.push_back(p); }
-	}
+	extract_bits_pushback(sieve, start, T(2), vec);
 }
 
 /** Split the task into blocks of size stripe_size; hope to get a better play with cache.
+  * As with sieve_to_list_pushback, the caller is responsible for reserving space in `vec`.
   */
 template <typename T>
 void prime_sieve_list<T>::primes_range_pushback(T start, T end, T stripe_size, std::vector<T> &vec)const
@@ -301,9 +416,18 @@ void sieve_stripe<T>::compute_section(T start, T end)
 	start += 1 - (start%2); // Ensure odd
 	if ( end > length ) { end = length; }
 	if ( start > end ) { return; }
+	perf_stripe_scope perf(perf_compute_section, uint64_t(end) - start + 1);
 	T endcache = (end-3)/2;
+	// Bit i is 3+2i, which is bit i+1 of the pattern
+	auto first = smallprimes.begin()+1;
+	if ( smallprimes.size() > 6 and presieve_bool_vector(sieve, (start-3)/2, endcache, 1) ) {
+		first += 6;
+		for (T p : {3, 5, 7, 11, 13, 17}) {
+			if ( p >= start and p <= end ) { sieve[(p-3)/2] = true; } // Put back the primes themselves
+		}
+	}
 	if ( start < smallprimes.back()*smallprimes.back() ) {
-		for (auto it = smallprimes.begin()+1; it != smallprimes.end(); ++it) {
+		for (auto it = first; it != smallprimes.end(); ++it) {
 			auto p = *it;
 			T ps = start + p - 1;
 			ps = ps - (ps % p);
@@ -315,7 +439,7 @@ void sieve_stripe<T>::compute_section(T start, T end)
 		}
 		return;
 	}
-	for (auto it = smallprimes.begin()+1; it != smallprimes.end(); ++it) {
+	for (auto it = first; it != smallprimes.end(); ++it) {
 		auto p = *it;
 		T ps = start + p - 1;
 		ps = ps - (ps % p);
@@ -330,11 +454,9 @@ template <typename T>
 std::vector<T> sieve_stripe<T>::prime_list()const
 {
 	std::vector<T> primes;
+	primes.reserve(prime_count_upper_bound(length));
 	primes.push_back(2);
-	T p = 3;
-	for (auto it = sieve.begin(); it != sieve.end(); ++it, p+=2) {
-		if ( *it ) { primes.push_back(p); }
-	}
+	extract_bits_pushback(sieve, T(3), T(2), primes);
 	return primes;
 }
 
@@ -351,7 +473,7 @@ std::vector<T> prime_list2(const T len)
 	T sqrt_len = sqrt(len);
 	if ( sqrt_len * sqrt_len < len ) { ++sqrt_len; }
 	prime_sieve_list<T> pl(sqrt_len);
-	std::vector<T> primes = pl.primes;
+	std::vector<T> primes = reserved_prime_list(pl.primes, len);
 	pl.sieve_to_list_pushback(sqrt_len+1, pl.partial_sieve(sqrt_len+1,len), primes);
 	return primes;
 }
@@ -366,21 +488,22 @@ std::vector<T> prime_list2(const T len, const T size)
 	T sqrt_len = sqrt(len);
 	if ( sqrt_len * sqrt_len < len ) { ++sqrt_len; }
 	prime_sieve_list<T> pl(sqrt_len);
-	std::vector<T> primes = pl.primes;
+	std::vector<T> primes = reserved_prime_list(pl.primes, len);
 	pl.primes_range_pushback(sqrt_len+1, len, size, primes);
 	return primes;
 }
 
 /** Version which computes the whole sieve at once, using a stripe size.
+  * By default the stripe size is chosen from the size of the L1 data cache.
   */
 template <typename T>
-std::vector<T> prime_list3(const T len, const T size)
+std::vector<T> prime_list3(const T len, const T size = default_stripe_size())
 {
 	if ( len<10 ) { return prime_list(len); }
 	T sqrt_len = sqrt(len);
 	if ( sqrt_len * sqrt_len < len ) { ++sqrt_len; }
 	prime_sieve_list<T> pl(sqrt_len);
-	std::vector<T> primes = pl.primes;
+	std::vector<T> primes = reserved_prime_list(pl.primes, len);
 	pl.sieve_to_list_pushback(sqrt_len+1, pl.partial_sieve(sqrt_len+1, len, size), primes);	
 	return primes;
 }
@@ -402,6 +525,10 @@ bool test4();
 bool test5();
 /** Tests that prime_list and class sieve_stripe return the same lists */
 bool test6();
+/** Tests prime_count_upper_bound, and that the lists are allocated just once */
+bool test16();
+/** Tests small_prime_list and the compile time tables against prime_list */
+bool test19();
 
 
 #endif // __SIEVE_TPP
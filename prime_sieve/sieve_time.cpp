@@ -59,6 +59,28 @@ std::vector<bool> dotime6b(unsigned int size)
 	return ss.get_sieve();
 }
 
+/** Use class wheel_sieve<T> to compute just the sieve; compare to dotime6a */
+std::vector<uint64_t> dotime6c(unsigned int size, unsigned int stripe)
+{
+	wheel_sieve<unsigned int> ws(size);
+	for (unsigned int n=0; n<=size; n+=stripe) {
+		ws.compute_section(n, n+stripe-1);
+		if ( n+stripe < n ) { break; }
+	}
+	return ws.get_sieve();
+}
+
+/** Use class wheel_sieve<T> for computing whole prime list; compare to dotime6 */
+std::vector<unsigned int> dotime6d(unsigned int size, unsigned int stripe)
+{
+	wheel_sieve<unsigned int> ws(size);
+	for (unsigned int n=0; n<=size; n+=stripe) {
+		ws.compute_section(n, n+stripe-1);
+		if ( n+stripe < n ) { break; }
+	}
+	return ws.prime_list();
+}
+
 // ----------------------------------------------------------------------------
 // Try to use multi-threading
 // ----------------------------------------------------------------------------
@@ -125,7 +147,269 @@ std::vector<bool> dotime7(unsigned int size, unsigned int ssize, bool usethreads
 
 std::vector<bool> dotime7(unsigned int size, bool usethreads)
 {
-	return dotime7(size,512000,usethreads);
+	return dotime7(size,default_stripe_size(),usethreads);
+}
+
+/** Any number of threads, with work stealing; replaces dotime7() */
+std::vector<bool> dotime8(unsigned int size, unsigned int ssize, unsigned int threads,
+	parallel_sieve_report *report)
+{
+	sieve_stripe<unsigned int> ss(size);
+	auto r = parallel_compute(ss, size, threads, ssize);
+	if ( report != nullptr ) { *report = std::move(r); }
+	return ss.sieve;
+}
+
+/** As dotime8() but with class wheel_sieve<T> */
+std::vector<uint64_t> dotime8a(unsigned int size, unsigned int ssize, unsigned int threads)
+{
+	wheel_sieve<unsigned int> ws(size);
+	parallel_compute(ws, size, threads, ssize);
+	return ws.get_sieve();
+}
+
+/** Primes in [start, start+length] with class bucket_sieve<uint64_t> */
+std::vector<uint64_t> dotime9(uint64_t start, uint64_t length, unsigned int stripe)
+{
+	return prime_list_bucket<uint64_t>(start, start+length, stripe);
+}
+
+/** As dotime9() but with prime_sieve_list<uint64_t>, which loops over every sieving prime in every stripe */
+std::vector<uint64_t> dotime9a(uint64_t start, uint64_t length, unsigned int stripe)
+{
+	prime_sieve_list<uint64_t> pl( integer_sqrt(start+length) + 1 );
+	std::vector<uint64_t> primes;
+	primes.reserve(prime_count_upper_bound(start, start+length));
+	pl.primes_range_pushback(start, start+length, stripe, primes);
+	return primes;
+}
+
+/** Sum of the primes up to size, streamed from prime_range<T> without making a list */
+uint64_t dotime10(unsigned int size)
+{
+	uint64_t sum = 0;
+	for (auto p : prime_range<unsigned int>(0, size)) { sum += p; }
+	return sum;
+}
+
+/** Number of primes up to size, by popcount of packed segments */
+uint64_t dotime11(unsigned int size, unsigned int threads)
+{
+	return count_primes<unsigned int>(0, size, threads);
+}
+
+/** pi(x) by the Lagarias-Miller-Odlyzko method */
+uint64_t dotime12(uint64_t x, unsigned int threads)
+{
+	return prime_pi<uint64_t>(x, threads);
+}
+
+/** Primes up to size with class atkin_sieve<T>, a stripe at a time */
+std::vector<unsigned int> dotime14(unsigned int size, unsigned int stripe)
+{
+	return engine_prime_list<atkin_sieve<unsigned int>>(size, stripe);
+}
+
+/** The same, with class sieve_stripe<T>, over identical stripes */
+std::vector<unsigned int> dotime14a(unsigned int size, unsigned int stripe)
+{
+	return engine_prime_list<sieve_stripe<unsigned int>>(size, stripe);
+}
+
+/** Sum of phi(n) over [start, start+length], from class multiplicative_sieve<uint64_t> */
+uint64_t dotime15(uint64_t start, uint64_t length)
+{
+	auto table = multiplicative_window<uint64_t>(start, start+length);
+	uint64_t sum = 0;
+	for (auto v : table.phi) { sum += v; }
+	return sum;
+}
+
+/** Queries with a bound which grows in `steps` equal steps up to size, using one
+  * growable_sieve<T> which is extended each time */
+unsigned int dotime16(unsigned int size, unsigned int steps)
+{
+	growable_sieve<unsigned int> gs;
+	unsigned int count = 0;
+	for (unsigned int k = 1; k <= steps; ++k) {
+		if ( gs.is_prime(size / steps * k - 1) ) { ++count; }
+	}
+	return count;
+}
+
+/** The same, but rebuilding a wheel_sieve<T> each time the bound grows */
+unsigned int dotime16a(unsigned int size, unsigned int steps)
+{
+	unsigned int count = 0;
+	for (unsigned int k = 1; k <= steps; ++k) {
+		unsigned int bound = size / steps * k;
+		wheel_sieve<unsigned int> ws(bound);
+		ws.compute_section(0, bound);
+		if ( ws.is_prime(bound - 1) ) { ++count; }
+	}
+	return count;
+}
+
+/** `queries` random is_prime() queries in [0, size], shared between `threads` threads,
+  * all using one lazy_sieve<uint64_t> */
+uint64_t dotime17(uint64_t size, unsigned int queries, unsigned int threads)
+{
+	lazy_sieve<uint64_t> ls(size);
+	std::vector<uint64_t> counts(threads, 0);
+	auto work = [&ls,&counts,size,queries,threads](unsigned int me) {
+		uint64_t state = me + 1, c = 0;
+		for (unsigned int i = me; i < queries; i += threads) {
+			state = state * 6364136223846793005ull + 1442695040888963407ull;
+			if ( ls.is_prime((state >> 11) % (size + 1)) ) { ++c; }
+		}
+		counts[me] = c;
+	};
+	std::vector<std::thread> workers;
+	for (unsigned int i = 1; i < threads; ++i) { workers.push_back(std::thread(work, i)); }
+	work(0);
+	for (auto &w : workers) { w.join(); }
+	uint64_t count = 0;
+	for (auto c : counts) { count += c; }
+	return count;
+}
+
+/** Sum of all the primes in `cl`, decoded 1024 at a time */
+uint64_t dotime18(const compressed_prime_list<unsigned int> &cl)
+{
+	unsigned int buffer[1024];
+	uint64_t sum = 0;
+	for (std::size_t i = 0; i < cl.size(); i += 1024) {
+		std::size_t n = std::min<std::size_t>(1024, cl.size() - i);
+		cl.decode(i, n, buffer);
+		for (std::size_t j = 0; j < n; ++j) { sum += buffer[j]; }
+	}
+	return sum;
+}
+
+/** Sum of `queries` primes from `cl`, at random indices */
+uint64_t dotime18a(const compressed_prime_list<unsigned int> &cl, unsigned int queries)
+{
+	uint64_t state = 1, sum = 0;
+	for (unsigned int i = 0; i < queries; ++i) {
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		sum += cl[(state >> 11) % cl.size()];
+	}
+	return sum;
+}
+
+/** Sum of all the primes in `primes`, to compare with dotime18() */
+uint64_t dotime18b(const std::vector<unsigned int> &primes)
+{
+	uint64_t sum = 0;
+	for (auto p : primes) { sum += p; }
+	return sum;
+}
+
+/** List of primes up to size with parallel_prime_list, using `threads` threads */
+std::vector<unsigned int> dotime19(unsigned int size, unsigned int threads)
+{
+	return parallel_prime_list(size, threads);
+}
+
+/** Sum of the primes up to size, with prime_sum */
+uint128_t dotime20(uint64_t size, unsigned int threads)
+{
+	return prime_sum(size, threads);
+}
+
+/** Sum of the primes up to size, by summing the list from prime_list2 */
+uint128_t dotime20a(uint64_t size)
+{
+	uint128_t sum = 0;
+	for (auto p : prime_list2(size, static_cast<uint64_t>(default_stripe_size()))) { sum += p; }
+	return sum;
+}
+
+/** Gap statistics and tuple counts for the primes up to size, returning the largest gap */
+uint64_t dotime21(uint64_t size, unsigned int threads)
+{
+	return gap_statistics<uint64_t>(0, size, prime_tuple_patterns<uint64_t>(), threads).max_gap();
+}
+
+/** The primes = a mod q up to size, with progression_sieve */
+std::vector<uint64_t> dotime22(uint64_t q, uint64_t a, uint64_t size)
+{
+	return progression_prime_list(q, a, size);
+}
+
+/** The primes = a mod q up to size, by filtering the list from prime_list2 */
+std::vector<uint64_t> dotime22a(uint64_t q, uint64_t a, uint64_t size)
+{
+	std::vector<uint64_t> primes;
+	for (auto p : prime_list2(size, static_cast<uint64_t>(default_stripe_size()))) {
+		if ( p % q == a ) { primes.push_back(p); }
+	}
+	return primes;
+}
+
+/** The k-th prime, with nth_prime */
+uint64_t dotime23(uint64_t k, unsigned int threads)
+{
+	return nth_prime<uint64_t>(k, threads);
+}
+
+/** The k-th prime, from the list made by prime_list2 up to `bound` */
+uint64_t dotime23a(uint64_t k, uint64_t bound)
+{
+	return prime_list2(bound, static_cast<uint64_t>(default_stripe_size()))[k-1];
+}
+
+/** Hardware counters for parallel_compute() with sieve_stripe<T>, as dotime8() */
+perf_report dotime24(unsigned int size, unsigned int ssize, unsigned int threads)
+{
+	perf_instrumentation(true);
+	dotime8(size, ssize, threads);
+	perf_instrumentation(false);
+	return perf_collect();
+}
+
+/** Hardware counters for prime_list3(), which sieves with partial_sieve a stripe at a time */
+perf_report dotime24a(unsigned int size, unsigned int ssize)
+{
+	perf_instrumentation(true);
+	prime_list3(size, ssize);
+	perf_instrumentation(false);
+	return perf_collect();
+}
+
+/** Answer the queries as one batch; returns the total number of primes found */
+uint64_t dotime25(const prime_batch_sieve<uint64_t> &bs, const std::vector<std::pair<uint64_t, uint64_t>> &queries)
+{
+	auto result = bs.query(queries);
+	uint64_t total = 0;
+	for (std::size_t i = 0; i < result.size(); ++i) { total += result.count(i); }
+	return total;
+}
+
+/** Answer the queries one at a time with prime_sieve_list<T>::primes_range */
+uint64_t dotime25a(const prime_sieve_list<uint64_t> &pl, const std::vector<std::pair<uint64_t, uint64_t>> &queries)
+{
+	uint64_t total = 0;
+	for (const auto &q : queries) { total += pl.primes_range(q.first, q.second).size(); }
+	return total;
+}
+
+/** The number of primes in [start, end], listed with prime_list_dispatch */
+std::size_t dotime26(uint64_t start, uint64_t end)
+{
+	return prime_list_dispatch(start, end).size();
+}
+
+/** As dotime26(), at 64 bits throughout, with packed_prime_list<uint64_t> */
+std::size_t dotime26a(uint64_t start, uint64_t end)
+{
+	return packed_prime_list<uint64_t>(start, end).size();
+}
+
+/** As dotime26(), at 32 bits throughout, with packed_prime_list<unsigned int> */
+std::size_t dotime26b(unsigned int start, unsigned int end)
+{
+	return packed_prime_list<unsigned int>(start, end).size();
 }
 
 /** Compare output of dotime7() with class sieve */
@@ -153,3 +437,17 @@ bool test_dotime6a7()
 	}
 	return true;
 }
+
+/** Compare output of dotime8() with class sieve */
+bool test_dotime8()
+{
+	for (int n=10; n<=10000; ++n) {
+		sieve<unsigned int> s1(n);
+		auto s2 = dotime8(n,1024,4);
+		if ( s1.get_sieve() != s2 ) {
+			cout << "test_dotime8() : fail, n=" << n << endl;
+			return false;
+		}
+	}
+	return true;
+}
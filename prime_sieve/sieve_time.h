@@ -6,6 +6,25 @@
  */
 
 #include "sieve.tpp"
+#include "wheel_sieve.tpp"
+#include "parallel_sieve.tpp"
+#include "bucket_sieve.tpp"
+#include "prime_range.tpp"
+#include "packed_sieve.tpp"
+#include "prime_table.h"
+#include "prime_count.tpp"
+#include "atkin_sieve.tpp"
+#include "multiplicative_sieve.tpp"
+#include "growable_sieve.tpp"
+#include "lazy_sieve.tpp"
+#include "compressed_list.tpp"
+#include "prime_sum.tpp"
+#include "gap_statistics.tpp"
+#include "progression_sieve.tpp"
+#include "nth_prime.tpp"
+#include "batch_query.tpp"
+#include "width_dispatch.tpp"
+#include "perf_counters.h"
 #include <vector>
 
 std::vector<unsigned int> dotime1(unsigned int size);
@@ -16,7 +35,42 @@ std::vector<unsigned int> dotime5(unsigned int size, unsigned int stripe);
 std::vector<unsigned int> dotime6(unsigned int size, unsigned int stripe);
 std::vector<bool> dotime6a(unsigned int size, unsigned int stripe);
 std::vector<bool> dotime6b(unsigned int size);
+std::vector<uint64_t> dotime6c(unsigned int size, unsigned int stripe);
+std::vector<unsigned int> dotime6d(unsigned int size, unsigned int stripe);
 std::vector<bool> dotime7(unsigned int size, bool usethreads);
 std::vector<bool> dotime7(unsigned int size, unsigned int ssize, bool usethreads);
+std::vector<bool> dotime8(unsigned int size, unsigned int ssize, unsigned int threads,
+	parallel_sieve_report *report = nullptr);
+std::vector<uint64_t> dotime8a(unsigned int size, unsigned int ssize, unsigned int threads);
+std::vector<uint64_t> dotime9(uint64_t start, uint64_t length, unsigned int stripe);
+std::vector<uint64_t> dotime9a(uint64_t start, uint64_t length, unsigned int stripe);
+uint64_t dotime10(unsigned int size);
+uint64_t dotime11(unsigned int size, unsigned int threads);
+uint64_t dotime12(uint64_t x, unsigned int threads);
+std::vector<unsigned int> dotime14(unsigned int size, unsigned int stripe);
+std::vector<unsigned int> dotime14a(unsigned int size, unsigned int stripe);
+uint64_t dotime15(uint64_t start, uint64_t length);
+unsigned int dotime16(unsigned int size, unsigned int steps);
+unsigned int dotime16a(unsigned int size, unsigned int steps);
+uint64_t dotime17(uint64_t size, unsigned int queries, unsigned int threads);
+uint64_t dotime18(const compressed_prime_list<unsigned int> &cl);
+uint64_t dotime18a(const compressed_prime_list<unsigned int> &cl, unsigned int queries);
+uint64_t dotime18b(const std::vector<unsigned int> &primes);
+std::vector<unsigned int> dotime19(unsigned int size, unsigned int threads);
+uint128_t dotime20(uint64_t size, unsigned int threads);
+uint128_t dotime20a(uint64_t size);
+uint64_t dotime21(uint64_t size, unsigned int threads);
+std::vector<uint64_t> dotime22(uint64_t q, uint64_t a, uint64_t size);
+std::vector<uint64_t> dotime22a(uint64_t q, uint64_t a, uint64_t size);
+uint64_t dotime23(uint64_t k, unsigned int threads);
+uint64_t dotime23a(uint64_t k, uint64_t bound);
+perf_report dotime24(unsigned int size, unsigned int ssize, unsigned int threads);
+perf_report dotime24a(unsigned int size, unsigned int ssize);
+uint64_t dotime25(const prime_batch_sieve<uint64_t> &bs, const std::vector<std::pair<uint64_t, uint64_t>> &queries);
+uint64_t dotime25a(const prime_sieve_list<uint64_t> &pl, const std::vector<std::pair<uint64_t, uint64_t>> &queries);
+std::size_t dotime26(uint64_t start, uint64_t end);
+std::size_t dotime26a(uint64_t start, uint64_t end);
+std::size_t dotime26b(unsigned int start, unsigned int end);
 bool test_dotime7();
 bool test_dotime6a7();
+bool test_dotime8();
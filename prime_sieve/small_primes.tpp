@@ -0,0 +1,130 @@
+/** @file: small_primes.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  The primes below 2^16, found by the compiler, so that the sieve classes don't have to
+ *  sieve for their small primes every time the program starts; see small_prime_list()
+ *  in sieve.tpp.  Also the pre-sieve pattern of the odd numbers free of 3, ..., 17.
+ */
+
+#ifndef __SMALL_PRIMES_TPP
+#define __SMALL_PRIMES_TPP
+
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <algorithm>
+#include <cstring>
+
+
+// --------------------------------------------------------------------------
+// Compile time sieve
+// --------------------------------------------------------------------------
+
+/** The table covers [0, small_prime_limit), which holds small_prime_count primes. */
+const uint32_t small_prime_limit = 65536;
+const std::size_t small_prime_count = 6542;
+
+/** std::array can't be written to in a constexpr function until C++17, so the sieve
+  * fills a plain array, which is then copied into a std::array. */
+struct small_primes_builder {
+	uint32_t value[small_prime_count];
+	constexpr small_primes_builder();
+};
+
+constexpr small_primes_builder::small_primes_builder()
+	: value{}
+{
+	bool composite[small_prime_limit] = {};
+	std::size_t n = 0;
+	for (uint32_t p = 2; p < small_prime_limit; ++p) {
+		if ( composite[p] ) { continue; }
+		value[n++] = p;
+		for (uint32_t q = p*p; q < small_prime_limit; q += p) { composite[q] = true; }
+	}
+}
+
+template <std::size_t... I>
+constexpr std::array<uint32_t, sizeof...(I)> small_primes_array(const small_primes_builder &b,
+	std::index_sequence<I...>)
+{
+	return {{ b.value[I]... }};
+}
+
+/** The primes below 2^16, in order */
+constexpr std::array<uint32_t, small_prime_count> small_primes
+	= small_primes_array(small_primes_builder(), std::make_index_sequence<small_prime_count>());
+
+static_assert(small_primes[0] == 2 and small_primes[small_prime_count-1] == 65521,
+	"small_prime_count is not the number of primes below small_prime_limit");
+
+
+
+
+// --------------------------------------------------------------------------
+// Pre-sieve pattern
+// --------------------------------------------------------------------------
+
+/** The odd numbers with no factor 3, 5, 7, 11, 13 or 17, as a bit pattern: bit i is
+  * 2i+1, which repeats with period 3*5*7*11*13*17 = 255255 bits (about 32KB).
+  * Initialising a segment from this, instead of to all ones, does the work of crossing
+  * off the six densest primes with one shift and OR per word.
+  * The pattern is worked out by the compiler.
+  */
+struct odd_presieve {
+	static const uint64_t period = 3*5*7*11*13*17;
+	static const unsigned int largest_prime = 17;
+	constexpr odd_presieve();
+	void fill(uint64_t *words, std::size_t nwords, uint64_t first)const;
+private:
+	static const std::size_t pattern_words = (period + 128)/64 + 1;
+	uint64_t pattern[pattern_words]; // A bit more than one period, so we can read past the end
+};
+
+constexpr odd_presieve::odd_presieve()
+	: pattern{}
+{
+	const unsigned int small[6] = { 3, 5, 7, 11, 13, 17 };
+	for (std::size_t w = 0; w < pattern_words; ++w) { pattern[w] = ~uint64_t(0); }
+	for (auto p : small) {
+		// 2i+1 is divisible by p when i = (p-1)/2 mod p
+		for (uint64_t i = (p-1)/2; i < 64*pattern_words; i += p) {
+			pattern[i/64] &= ~(uint64_t(1) << (i%64));
+		}
+	}
+}
+
+/** Sets `words` to the pattern, starting from bit `first` (i.e. the odd number 2*first+1).
+  * The multiples of 3, ..., 17 are cleared, including those primes themselves. */
+inline void odd_presieve::fill(uint64_t *words, std::size_t nwords, uint64_t first)const
+{
+	uint64_t offset = first % period;
+	std::size_t w = 0;
+	while ( w < nwords ) {
+		// Copy until the offset wraps around, so the inner loop has no branches
+		std::size_t run = std::min<std::size_t>(nwords - w, (period - offset + 63) / 64);
+		std::size_t q = offset/64;
+		unsigned int r = offset%64;
+		if ( r == 0 ) {
+			std::memcpy(words + w, pattern + q, run*sizeof(uint64_t));
+		} else {
+			for (std::size_t j = 0; j < run; ++j) {
+				words[w+j] = (pattern[q+j] >> r) | (pattern[q+j+1] << (64-r));
+			}
+		}
+		w += run;
+		offset = (offset + 64*run) % period;
+	}
+}
+
+/** The pattern, which is a compile time constant. */
+inline const odd_presieve& get_odd_presieve()
+{
+	static constexpr odd_presieve pattern{};
+	return pattern;
+}
+
+
+#endif // __SMALL_PRIMES_TPP
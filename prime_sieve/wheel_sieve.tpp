@@ -0,0 +1,223 @@
+/** @file: wheel_sieve.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  A sieve which only stores numbers coprime to 30, packed into 64-bit words.
+ */
+
+#ifndef __WHEEL_SIEVE_TPP
+#define __WHEEL_SIEVE_TPP
+
+
+#include "sieve.tpp"
+
+#include <vector>
+#include <cstdint>
+#include <initializer_list>
+
+
+/** The numbers in [0,30) which are coprime to 30; bit i of a block is 30k+wheel30_residues[i] */
+constexpr unsigned int wheel30_residues[8] = { 1, 7, 11, 13, 17, 19, 23, 29 };
+
+/** Inverse of the above: the bit used for residue r, or 8 if r is not coprime to 30 */
+constexpr unsigned int wheel30_bit[30] = {
+	8, 0, 8, 8, 8, 8, 8, 1, 8, 8,
+	8, 2, 8, 3, 8, 8, 8, 4, 8, 5,
+	8, 8, 8, 6, 8, 8, 8, 8, 8, 7 };
+
+
+// --------------------------------------------------------------------------
+// Pre-sieve pattern
+// --------------------------------------------------------------------------
+
+/** The numbers coprime to 30 with no factor 7, 11, 13 or 17, one byte per block of 30 as
+  * in class wheel_sieve<T>.  This repeats with period 7*11*13*17 = 17017 blocks, so
+  * ANDing a section of the sieve with it does the work of crossing off those four primes.
+  * The pattern is worked out by the compiler.
+  */
+struct wheel_presieve {
+	static const uint64_t period = 7*11*13*17;
+	static const unsigned int largest_prime = 17;
+	constexpr wheel_presieve();
+	unsigned int byte(uint64_t block)const { return pattern[block % period]; }
+	inline uint64_t word(uint64_t block)const;
+private:
+	unsigned char pattern[period + 7]; // One period, and 7 more bytes to read past the end
+};
+
+constexpr wheel_presieve::wheel_presieve()
+	: pattern{}
+{
+	for (uint64_t k = 0; k < period + 7; ++k) {
+		for (unsigned int i=0; i<8; ++i) {
+			uint64_t n = 30*k + wheel30_residues[i];
+			if ( n%7 != 0 and n%11 != 0 and n%13 != 0 and n%17 != 0 ) { pattern[k] |= 1u << i; }
+		}
+	}
+}
+
+/** The 8 blocks starting at `block`, laid out as one word of the sieve */
+inline uint64_t wheel_presieve::word(uint64_t block)const
+{
+	const unsigned char *bytes = pattern + block % period;
+	uint64_t w = 0;
+	for (unsigned int j=0; j<8; ++j) { w |= uint64_t(bytes[j]) << (8*j); }
+	return w;
+}
+
+/** The pattern, which is a compile time constant. */
+inline const wheel_presieve& get_wheel_presieve()
+{
+	static constexpr wheel_presieve pattern{};
+	return pattern;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// class wheel_sieve<T> code
+// --------------------------------------------------------------------------
+
+/** Prime sieve which skips multiples of 2, 3 and 5.
+  * Each block of 30 integers 30k, ..., 30k+29 has only 8 members coprime to 30,
+  * so fits into one byte.  Block k is stored in bits 8*(k%8) to 8*(k%8)+7 of
+  * word k/8 of a std::vector<uint64_t>.  This uses 1/30 byte per integer, against
+  * 1/16 for the odds-only std::vector<bool> in sieve<T> and sieve_stripe<T>.
+  *
+  * The interface follows sieve_stripe<T>: the constructor finds the small primes and
+  * allocates the sieve, and then compute_section() can be called on sub-ranges.
+  * Sections are rounded out to whole blocks of 30; if calling from multiple threads,
+  * make sections start at a multiple of 240 so that different threads work on different
+  * words.
+  */
+template <typename T>
+class wheel_sieve {
+public:
+	wheel_sieve(const T len);
+	bool is_prime(const T p)const;
+	void compute_section(T start, T end);
+	std::vector<T> prime_list()const;
+	const std::vector<uint64_t>& get_sieve()const { return sieve; }
+private:
+	T length;
+	std::vector<uint64_t> sieve;
+	std::vector<T> smallprimes;
+};
+
+/** Constructor: finds the primes up to sqrt(len) and allocates the sieve, with
+  * everything other than 1 marked as prime.
+  */
+template <typename T>
+wheel_sieve<T>::wheel_sieve(const T len)
+	: length{len}
+{
+	T blocks = len/30 + 1;
+	sieve.resize((blocks+7)/8, ~uint64_t(0));
+	// Clear numbers larger than len in the final block, and any unused blocks
+	T lastblock = len/30;
+	for (unsigned int i=0; i<8; ++i) {
+		if ( wheel30_residues[i] > len%30 ) {
+			sieve[lastblock/8] &= ~(uint64_t(1) << ((lastblock%8)*8 + i));
+		}
+	}
+	for (T b = lastblock+1; b%8 != 0; ++b) {
+		sieve[b/8] &= ~(uint64_t(0xff) << ((b%8)*8));
+	}
+	sieve[0] &= ~uint64_t(1); // 1 is not prime
+	// Find small primes
+	T sqrt_len = sqrt(len);
+	if ( sqrt_len * sqrt_len < len ) { ++sqrt_len; }
+	if ( sqrt_len < 3 ) { sqrt_len = 3; } // Smallest length class sieve<T> can handle
+	prime_sieve_list<T> pl(sqrt_len);
+	smallprimes = std::move(pl.primes);
+}
+
+template <typename T>
+bool wheel_sieve<T>::is_prime(const T p)const
+{
+	if ( p==2 or p==3 or p==5 ) { return p<=length; }
+	if ( p>length ) { return false; }
+	unsigned int bit = wheel30_bit[p%30];
+	if ( bit==8 ) { return false; }
+	T block = p/30;
+	return ( sieve[block/8] >> ((block%8)*8 + bit) ) & 1;
+}
+
+/** Cancel the multiples of the small primes in the blocks which contain start to end.
+  * The primes 7 to 17 are dealt with by the wheel_presieve pattern.  For each prime
+  * p>=19, the multiples p*q with q coprime to 30 fall into 8 classes according to q mod
+  * 30; in each class the block index increases by exactly p as q increases by 30, and
+  * the bit within the block is fixed.
+  */
+template <typename T>
+void wheel_sieve<T>::compute_section(T start, T end)
+{
+	if ( end > length ) { end = length; }
+	if ( start > end ) { return; }
+	T startblock = start/30, endblock = end/30;
+	T lowest = startblock*30;
+	const wheel_presieve &pre = get_wheel_presieve();
+	for (T b = startblock; b <= endblock; ) {
+		if ( b%8 == 0 and endblock - b >= 7 ) {
+			sieve[b/8] &= pre.word(b);
+			b += 8;
+		} else {
+			sieve[b/8] &= ~(uint64_t(~pre.byte(b) & 0xff) << ((b%8)*8));
+			++b;
+		}
+	}
+	if ( startblock == 0 ) {
+		// Put back the primes the pattern crossed off
+		for (T p : {7, 11, 13, 17}) {
+			if ( p <= length ) { sieve[0] |= uint64_t(1) << wheel30_bit[p]; }
+		}
+	}
+	for (auto it = smallprimes.begin(); it != smallprimes.end(); ++it) {
+		auto p = *it;
+		if ( p <= wheel_presieve::largest_prime ) { continue; }
+		if ( p > length/p ) { break; }
+		T lo = p*p;
+		if ( lo < lowest ) { lo = lowest; }
+		if ( lo/30 > endblock ) { break; }
+		T qmin = lo/p + (lo%p != 0); // Smallest q with p*q >= lo; lo + p - 1 could wrap
+		for (unsigned int i=0; i<8; ++i) {
+			T r = wheel30_residues[i];
+			T k = ( qmin <= r ) ? 0 : (qmin - r + 29) / 30;
+			T pr = p*r;
+			unsigned int bit = wheel30_bit[pr%30];
+			for (T b = p*k + pr/30; b <= endblock; b += p) {
+				sieve[b/8] &= ~(uint64_t(1) << ((b%8)*8 + bit));
+			}
+		}
+	}
+}
+
+template <typename T>
+std::vector<T> wheel_sieve<T>::prime_list()const
+{
+	std::vector<T> primes;
+	primes.reserve(prime_count_upper_bound(length));
+	T small[3] = {2, 3, 5};
+	for (auto p : small) {
+		if ( p <= length ) { primes.push_back(p); }
+	}
+	for (T w = 0; w < sieve.size(); ++w) {
+		uint64_t bits = sieve[w];
+		while ( bits != 0 ) {
+			unsigned int t = __builtin_ctzll(bits);
+			primes.push_back( (w*8 + t/8)*30 + wheel30_residues[t%8] );
+			bits &= bits - 1;
+		}
+	}
+	return primes;
+}
+
+
+
+/** Various testing routines */
+/** Tests that prime_list and class wheel_sieve return the same lists */
+bool test7();
+
+
+#endif // __WHEEL_SIEVE_TPP
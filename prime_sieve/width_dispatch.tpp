@@ -0,0 +1,200 @@
+/** @file: width_dispatch.tpp
+ *  @author: Matthew Daws
+ *
+ *  Some Prime Sieve (aka Sieve of Eratosthenes) code.
+ *  A 64-bit front end which runs the 32-bit instantiation of the sieve on every segment
+ *  where the numbers fit, and 64-bit only where they don't; and a list of primes stored
+ *  as 32-bit offsets from a 64-bit base, so that it costs 4 bytes a prime either way.
+ */
+
+#ifndef __WIDTH_DISPATCH_TPP
+#define __WIDTH_DISPATCH_TPP
+
+
+#include "sieve.tpp"
+#include "packed_sieve.tpp"
+#include "bit_extract.tpp"
+#include "cache_info.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include <limits>
+#include <algorithm>
+
+
+// --------------------------------------------------------------------------
+// class offset_prime_list code
+// --------------------------------------------------------------------------
+
+/** An increasing list of 64-bit numbers, stored as 32-bit offsets.  The list is split into
+  * blocks, each with a 64-bit base, and a new block starts whenever a value is 2^32 or more
+  * past the current base; for primes that is once every 2^32 integers, so there are very
+  * few blocks, and operator[] finds the block by binary search.
+  */
+class offset_prime_list {
+public:
+	offset_prime_list() { }
+	std::size_t size()const { return offsets.size(); }
+	bool empty()const { return offsets.empty(); }
+	inline uint64_t operator[](std::size_t i)const;
+	inline void push_back(uint64_t value);
+	void append_odd_bits(const uint64_t *words, std::size_t bits, uint64_t start);
+	template <typename Func>
+	void for_each(Func f)const;
+	std::vector<uint64_t> to_vector()const;
+	std::size_t memory_bytes()const
+		{ return offsets.capacity() * sizeof(uint32_t) + blocks.capacity() * sizeof(block); }
+	std::size_t num_blocks()const { return blocks.size(); }
+	void reserve(std::size_t n) { offsets.reserve(n); }
+private:
+	struct block {
+		std::size_t first;     // Index of the first entry
+		uint64_t base;
+	};
+	std::vector<uint32_t> offsets;
+	std::vector<block> blocks;
+	inline void cover(uint64_t lo, uint64_t hi);
+};
+
+/** Make sure that values lo to hi can be stored in the current block, starting a new one
+  * from lo if not */
+inline void offset_prime_list::cover(uint64_t lo, uint64_t hi)
+{
+	if ( blocks.empty() or hi - blocks.back().base > std::numeric_limits<uint32_t>::max() ) {
+		blocks.push_back(block{offsets.size(), lo});
+	}
+}
+
+inline uint64_t offset_prime_list::operator[](std::size_t i)const
+{
+	auto it = std::upper_bound(blocks.begin(), blocks.end(), i,
+		[](std::size_t j, const block &b) { return j < b.first; });
+	return (it-1)->base + offsets[i];
+}
+
+/** Append `value`, which must be larger than the last value */
+inline void offset_prime_list::push_back(uint64_t value)
+{
+	cover(value, value);
+	offsets.push_back(static_cast<uint32_t>(value - blocks.back().base));
+}
+
+/** Append the odd numbers start + 2i, for i < bits, for which bit i of `words` is set.
+  * They must all be larger than the last value.  The bits are extracted as 32-bit offsets,
+  * whatever the size of the numbers. */
+inline void offset_prime_list::append_odd_bits(const uint64_t *words, std::size_t bits, uint64_t start)
+{
+	if ( bits == 0 ) { return; }
+	cover(start, start + 2*(bits-1));
+	uint32_t first = static_cast<uint32_t>(start - blocks.back().base);
+	extract_bits_pushback(static_cast<const void*>(words), bits, first, uint32_t(2), offsets);
+}
+
+/** Call f(value) for each value in order */
+template <typename Func>
+void offset_prime_list::for_each(Func f)const
+{
+	for (std::size_t b = 0; b < blocks.size(); ++b) {
+		std::size_t last = ( b+1 < blocks.size() ) ? blocks[b+1].first : offsets.size();
+		uint64_t base = blocks[b].base;
+		for (std::size_t i = blocks[b].first; i < last; ++i) { f(base + offsets[i]); }
+	}
+}
+
+inline std::vector<uint64_t> offset_prime_list::to_vector()const
+{
+	std::vector<uint64_t> values;
+	values.reserve(offsets.size());
+	for_each([&values](uint64_t v) { values.push_back(v); });
+	return values;
+}
+
+
+
+
+// --------------------------------------------------------------------------
+// Width dispatch code
+// --------------------------------------------------------------------------
+
+/** The primes in [start, end] as a std::vector<T>, sieving packed segments of about
+  * `segment_size` integers (by default filling the L1 data cache) with
+  * packed_sieve_segment<T> and extracting them a word at a time.  Everything is done at
+  * the width of T. */
+template <typename T>
+std::vector<T> packed_prime_list(T start, T end, T segment_size = 0)
+{
+	std::vector<T> primes;
+	if ( end < start or end < 2 ) { return primes; }
+	primes.reserve(prime_count_upper_bound(start, end));
+	if ( start <= 2 ) { primes.push_back(2); }
+	uint64_t first = std::max<uint64_t>(start, 3);
+	first += 1 - first%2;
+	if ( first > end ) { return primes; }
+	uint64_t bits = ( segment_size == 0 ) ? default_stripe_size() / 2 : segment_size / 2;
+	bits -= bits % 64;
+	if ( bits == 0 ) { bits = 64; }
+	std::vector<T> small = small_prime_list<T>(integer_sqrt(end) + 1);
+	std::vector<uint64_t> words(bits / 64);
+	uint64_t total_bits = (end - first) / 2 + 1;
+	for (uint64_t b0 = 0; b0 < total_bits; b0 += bits) {
+		T b = static_cast<T>(std::min(bits, total_bits - b0));
+		T s = static_cast<T>(first + 2*b0);
+		packed_sieve_segment(small, s, b, words.data());
+		extract_bits_pushback(static_cast<const void*>(words.data()), static_cast<std::size_t>(b), s, T(2), primes);
+	}
+	return primes;
+}
+
+/** The primes in [start, end], for any 64-bit range, as an offset_prime_list.
+  *
+  * The range is sieved in packed segments of about `segment_size` integers (by default
+  * filling the L1 data cache).  Each segment which lies below 2^32 is sieved by
+  * packed_sieve_segment<uint32_t>, whose index arithmetic, divisions and sieving primes
+  * are half the width of the uint64_t version; only segments past 2^32 use
+  * packed_sieve_segment<uint64_t>.  Either way the primes are extracted as 32-bit offsets
+  * from a base, twice as many to a SIMD register, into the list, which takes half the
+  * memory of a std::vector<uint64_t>.  So a range below 2^32 costs about what the
+  * `unsigned int` instantiation does, while the caller never has to choose.
+  */
+inline offset_prime_list prime_list_dispatch(uint64_t start, uint64_t end, uint64_t segment_size = 0)
+{
+	offset_prime_list list;
+	if ( end < start or end < 2 ) { return list; }
+	list.reserve(prime_count_upper_bound(start, end));
+	if ( start <= 2 ) { list.push_back(2); }
+	uint64_t first = std::max<uint64_t>(start, 3);
+	first += 1 - first%2;
+	if ( first > end ) { return list; }
+	uint64_t bits = ( segment_size == 0 ) ? default_stripe_size() / 2 : segment_size / 2;
+	bits -= bits % 64;
+	if ( bits == 0 ) { bits = 64; }
+	const uint64_t top32 = std::numeric_limits<uint32_t>::max();
+	uint64_t root = integer_sqrt(end) + 1;
+	std::vector<uint32_t> small32 = small_prime_list<uint32_t>(static_cast<uint32_t>(std::min<uint64_t>(root, 65536)));
+	std::vector<uint64_t> small64;
+	if ( end > top32 ) { small64 = small_prime_list<uint64_t>(root); }
+	std::vector<uint64_t> words(bits / 64);
+	uint64_t total_bits = (end - first) / 2 + 1;
+	for (uint64_t b0 = 0; b0 < total_bits; b0 += bits) {
+		uint64_t b = std::min(bits, total_bits - b0);
+		uint64_t s = first + 2*b0;
+		if ( s + 2*(b-1) <= top32 ) {
+			packed_sieve_segment(small32, static_cast<uint32_t>(s), static_cast<uint32_t>(b), words.data());
+		} else {
+			packed_sieve_segment(small64, s, b, words.data());
+		}
+		list.append_odd_bits(words.data(), static_cast<std::size_t>(b), s);
+	}
+	return list;
+}
+
+
+
+/** Various testing routines */
+/** Tests prime_list_dispatch and offset_prime_list against prime_list and prime_sieve_list */
+bool test30();
+
+
+#endif // __WIDTH_DISPATCH_TPP